@@ -0,0 +1,435 @@
+// reactor_bench_client: load generator for the echo server, built on the
+// same Reactor and coroutine layer it measures.
+//
+// Opens N connections and sends M newline-terminated messages on each, or
+// with --http PATH, M pipelined "GET PATH" requests on keep-alive
+// connections to react1 --http, wrk style, or with --kv SET_PERCENT a
+// pipelined GET/SET mix over --keys keys against react1 --kv (or any
+// Redis server); SET values are --payload bytes.
+// Closed loop (default) keeps --pipeline messages in flight per
+// connection. Open loop (--rate) sends at a fixed total rate regardless
+// of replies and measures latency from each message's scheduled send
+// time, so a stalled server shows up as latency instead of as fewer
+// requests (no coordinated omission).
+//
+//     reactor_bench_client --connections 64 --messages 10000 --pipeline 8
+//     reactor_bench_client --rate 50000 --connections 16 --messages 20000
+//     reactor_bench_client --http / --connections 64 --pipeline 16
+//     reactor_bench_client --kv 10 --keys 100000 --pipeline 32
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <strings.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "CoroConnection.hpp"
+#include "LatencyHistogram.hpp"
+#include "Reactor.hpp"
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 9000;
+    int connections = 16;
+    int messages = 10000;
+    int pipeline = 16;
+    // Messages per second over all connections; 0 means closed loop
+    double rate = 0;
+    int payload = 16;
+    int timeoutSec = 60;
+    // Non-empty for HTTP mode
+    std::string httpPath;
+    // Percentage of SETs in KV mode, -1 when not in KV mode
+    int kvSetPercent = -1;
+    int keys = 10000;
+};
+
+struct Run {
+    Reactor* reactor;
+    Options opt;
+    LatencyHistogram latency;
+    uint64_t received = 0;
+    uint64_t bytesIn = 0;
+    int failed = 0;
+    // HTTP responses with a status outside 2xx, or KV error replies
+    uint64_t non2xx = 0;
+    int active = 0;
+    uint64_t firstSend = 0;
+    uint64_t lastReply = 0;
+};
+
+struct ConnState {
+    ConnState(int fd, Reactor* reactor, int messages)
+        : conn(fd, reactor), sentAt(messages) {}
+
+    CoroConnection conn;
+    // Send (or scheduled send) time per sequence number; replies come
+    // back in order
+    std::vector<uint64_t> sentAt;
+    int sent = 0;
+    bool closed = false;
+};
+
+static uint64_t nowNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// What the reader made of one reply
+struct Reply {
+    size_t bytes;
+    bool ok;
+};
+
+static void appendMessage(std::string& out, const Options& opt, int conn, int seq)
+{
+    if (!opt.httpPath.empty()) {
+        out += "GET " + opt.httpPath + " HTTP/1.1\r\nHost: " + opt.host + "\r\n\r\n";
+        return;
+    }
+    if (opt.kvSetPercent >= 0) {
+        // splitmix64 of (conn, seq): the same mix on every run
+        uint64_t x = (uint64_t(conn) << 32 | uint32_t(seq)) + 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        std::string key = "key:" + std::to_string(x % uint64_t(opt.keys));
+        if (int(x >> 40) % 100 < opt.kvSetPercent) {
+            std::string value(size_t(opt.payload), 'x');
+            out += "*3\r\n$3\r\nSET\r\n$" + std::to_string(key.size()) + "\r\n" + key +
+                "\r\n$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+        } else {
+            out += "*2\r\n$3\r\nGET\r\n$" + std::to_string(key.size()) + "\r\n" + key + "\r\n";
+        }
+        return;
+    }
+    size_t start = out.size();
+    out += "m" + std::to_string(conn) + "-" + std::to_string(seq) + " ";
+    while (out.size() - start + 1 < size_t(opt.payload)) {
+        out.push_back('x');
+    }
+    out.push_back('\n');
+}
+
+static AsyncGenerator<Reply> echoReplies(CoroConnection& conn)
+{
+    auto lines = conn.lines();
+    while (auto line = co_await lines.next()) {
+        co_yield Reply{line->size() + 1, true};
+    }
+}
+
+// RESP replies to GET and SET: simple strings, errors, integers and
+// bulk strings
+static AsyncGenerator<Reply> kvReplies(CoroConnection& conn)
+{
+    auto lines = conn.lines();
+    while (auto line = co_await lines.next()) {
+        Reply reply{line->size() + 1, !line->empty() && (*line)[0] != '-'};
+        if (!line->empty() && (*line)[0] == '$') {
+            long long n = std::strtoll(line->data() + 1, nullptr, 10);
+            if (n >= 0) {
+                if (!co_await conn.read(size_t(n) + 2)) {
+                    co_return;
+                }
+                reply.bytes += size_t(n) + 2;
+            }
+        }
+        co_yield reply;
+    }
+}
+
+static bool startsWithIgnoreCase(std::string_view s, std::string_view prefix)
+{
+    return s.size() >= prefix.size() && strncasecmp(s.data(), prefix.data(), prefix.size()) == 0;
+}
+
+// HTTP/1.1 responses framed by Content-Length or chunked coding
+static AsyncGenerator<Reply> httpReplies(CoroConnection& conn)
+{
+    auto lines = conn.lines();
+    while (true) {
+        Reply reply{0, false};
+        size_t length = 0;
+        bool chunked = false;
+        bool headDone = false;
+
+        auto status = co_await lines.next();
+        if (!status) {
+            co_return;
+        }
+        reply.bytes += status->size() + 1;
+        reply.ok = status->size() > 9 && (*status)[9] == '2';
+
+        while (auto line = co_await lines.next()) {
+            reply.bytes += line->size() + 1;
+            std::string_view header = *line;
+            if (header == "\r" || header.empty()) {
+                headDone = true;
+                break;
+            }
+            if (startsWithIgnoreCase(header, "content-length:")) {
+                length = std::strtoull(header.data() + 15, nullptr, 10);
+            } else if (startsWithIgnoreCase(header, "transfer-encoding:")) {
+                chunked = header.find("chunked") != std::string_view::npos;
+            }
+        }
+        if (!headDone) {
+            co_return;
+        }
+
+        if (chunked) {
+            while (true) {
+                auto size = co_await lines.next();
+                if (!size) {
+                    co_return;
+                }
+                reply.bytes += size->size() + 1;
+                size_t n = std::strtoull(size->data(), nullptr, 16);
+                // Chunk data plus its CRLF; the last chunk's CRLF ends the body
+                auto data = co_await conn.read(n + 2);
+                if (!data) {
+                    co_return;
+                }
+                reply.bytes += n + 2;
+                if (n == 0) {
+                    break;
+                }
+            }
+        } else if (length > 0) {
+            if (!co_await conn.read(length)) {
+                co_return;
+            }
+            reply.bytes += length;
+        }
+        co_yield reply;
+    }
+}
+
+static CoroTask<int> connectTo(Reactor* reactor, const Options& opt)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr);
+
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        perror("connect");
+        close(fd);
+        co_return -1;
+    }
+
+    co_await reactor->writable(fd);
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0) {
+        std::cerr << "connect: " << strerror(err) << std::endl;
+        reactor->unwatchIo(fd);
+        close(fd);
+        co_return -1;
+    }
+    co_return fd;
+}
+
+// Open loop: sends whatever is due every millisecond
+static CoroTask<void> pace(Run& run, std::shared_ptr<ConnState> s, int id)
+{
+    const Options& opt = run.opt;
+    double perConn = opt.rate / opt.connections;
+    uint64_t start = nowNs();
+    std::string out;
+
+    while (s->sent < opt.messages && !s->closed) {
+        uint64_t due = uint64_t(double(nowNs() - start) * perConn / 1e9) + 1;
+        if (due > uint64_t(opt.messages)) {
+            due = opt.messages;
+        }
+
+        out.clear();
+        while (uint64_t(s->sent) < due) {
+            appendMessage(out, opt, id, s->sent);
+            s->sentAt[s->sent] = start + uint64_t(s->sent * 1e9 / perConn);
+            s->sent++;
+        }
+        if (!out.empty() && !co_await s->conn.write(out)) {
+            s->closed = true;
+            break;
+        }
+
+        co_await run.reactor->sleep(1);
+    }
+}
+
+static CoroTask<void> session(Run& run, int id)
+{
+    const Options& opt = run.opt;
+    int fd = co_await connectTo(run.reactor, opt);
+    if (fd < 0) {
+        run.failed++;
+    } else {
+        auto s = std::make_shared<ConnState>(fd, run.reactor, opt.messages);
+        if (run.firstSend == 0) {
+            run.firstSend = nowNs();
+        }
+
+        std::string out;
+        if (opt.rate > 0) {
+            run.reactor->spawn(pace(run, s, id));
+        } else {
+            int window = opt.pipeline < opt.messages ? opt.pipeline : opt.messages;
+            uint64_t now = nowNs();
+            for (; s->sent < window; s->sent++) {
+                appendMessage(out, opt, id, s->sent);
+                s->sentAt[s->sent] = now;
+            }
+            s->closed = !co_await s->conn.write(out);
+        }
+
+        auto replies = !opt.httpPath.empty() ? httpReplies(s->conn)
+            : opt.kvSetPercent >= 0 ? kvReplies(s->conn) : echoReplies(s->conn);
+        int received = 0;
+        while (!s->closed && received < opt.messages) {
+            auto reply = co_await replies.next();
+            if (!reply) {
+                run.failed++;
+                break;
+            }
+
+            uint64_t now = nowNs();
+            uint64_t sentAt = s->sentAt[received];
+            run.latency.record(now > sentAt ? now - sentAt : 0);
+            run.received++;
+            run.bytesIn += reply->bytes;
+            run.non2xx += !reply->ok;
+            run.lastReply = now;
+            received++;
+
+            if (opt.rate == 0 && s->sent < opt.messages) {
+                out.clear();
+                appendMessage(out, opt, id, s->sent);
+                s->sentAt[s->sent++] = now;
+                s->closed = !co_await s->conn.write(out);
+            }
+        }
+        s->closed = true;
+    }
+
+    if (--run.active == 0) {
+        run.reactor->stop();
+    }
+}
+
+static void usage()
+{
+    std::cerr << "usage: reactor_bench_client [--host H] [--port P] [--connections N]\n"
+                 "         [--messages M] [--pipeline D] [--rate MSGS_PER_SEC]\n"
+                 "         [--payload BYTES] [--timeout SECONDS] [--http PATH]\n"
+                 "         [--kv SET_PERCENT] [--keys N]" << std::endl;
+    exit(2);
+}
+
+static Options parseOptions(int argc, char** argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+        }
+        const char* value = argv[++i];
+        if (arg == "--host") {
+            opt.host = value;
+        } else if (arg == "--port") {
+            opt.port = uint16_t(std::atoi(value));
+        } else if (arg == "--connections") {
+            opt.connections = std::atoi(value);
+        } else if (arg == "--messages") {
+            opt.messages = std::atoi(value);
+        } else if (arg == "--pipeline") {
+            opt.pipeline = std::atoi(value);
+        } else if (arg == "--rate") {
+            opt.rate = std::atof(value);
+        } else if (arg == "--payload") {
+            opt.payload = std::atoi(value);
+        } else if (arg == "--timeout") {
+            opt.timeoutSec = std::atoi(value);
+        } else if (arg == "--http") {
+            opt.httpPath = value;
+        } else if (arg == "--kv") {
+            opt.kvSetPercent = std::atoi(value);
+        } else if (arg == "--keys") {
+            opt.keys = std::atoi(value);
+        } else {
+            usage();
+        }
+    }
+    if (opt.connections < 1 || opt.messages < 1 || opt.pipeline < 1 || opt.keys < 1 ||
+        opt.kvSetPercent > 100) {
+        usage();
+    }
+    return opt;
+}
+
+int main(int argc, char** argv)
+{
+    Reactor reactor;
+    Run run;
+    run.reactor = &reactor;
+    run.opt = parseOptions(argc, argv);
+    const Options& opt = run.opt;
+
+    run.active = opt.connections;
+    for (int i = 0; i < opt.connections; i++) {
+        reactor.spawn(session(run, i));
+    }
+
+    reactor.addTimer(uint64_t(opt.timeoutSec) * 1000, false, [&reactor]() {
+            std::cerr << "timed out" << std::endl;
+            reactor.stop();
+            });
+    reactor.eventLoop();
+
+    double seconds = run.lastReply > run.firstSend ? (run.lastReply - run.firstSend) / 1e9 : 0;
+    uint64_t expected = uint64_t(opt.connections) * opt.messages;
+    auto us = [](uint64_t ns) { return ns / 1000.0; };
+
+    std::cout << "target:      " << opt.host << ":" << opt.port << "\n"
+              << "connections: " << opt.connections << " (" << run.failed << " failed)\n"
+              << "mode:        ";
+    if (opt.rate > 0) {
+        std::cout << "open loop, " << opt.rate << " msg/s\n";
+    } else {
+        std::cout << "closed loop, pipeline " << opt.pipeline << "\n";
+    }
+    if (!opt.httpPath.empty()) {
+        std::cout << "http:        GET " << opt.httpPath << ", " << run.non2xx << " non-2xx\n";
+    }
+    if (opt.kvSetPercent >= 0) {
+        std::cout << "kv:          " << opt.kvSetPercent << "% SET over " << opt.keys << " keys, "
+                  << run.non2xx << " errors\n";
+    }
+    std::cout << "replies:     " << run.received << "/" << expected << " in " << seconds << " s\n"
+              << "throughput:  " << (seconds > 0 ? run.received / seconds : 0) << " msg/s, "
+              << (seconds > 0 ? run.bytesIn / seconds / 1e6 : 0) << " MB/s in\n"
+              << "latency us:  p50=" << us(run.latency.percentile(0.50))
+              << " p90=" << us(run.latency.percentile(0.90))
+              << " p99=" << us(run.latency.percentile(0.99))
+              << " p999=" << us(run.latency.percentile(0.999))
+              << " max=" << us(run.latency.max())
+              << " mean=" << us(uint64_t(run.latency.mean())) << std::endl;
+
+    return run.received == expected ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+// Echo round trips per second through the callback ConnectionHandler and
+// through coroEchoSession, served by the same Reactor.
+//
+// A client thread keeps C connections busy in lock step: one line out on
+// every connection, then one reply in from each, R times.
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "AcceptorHandler.hpp"
+#include "CoroConnection.hpp"
+#include "Reactor.hpp"
+
+static int listenOnAnyPort(uint16_t& port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1024) < 0) {
+        perror("bind/listen");
+        exit(1);
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static void readReply(int fd)
+{
+    char c;
+    while (recv(fd, &c, 1, 0) == 1 && c != '\n') {}
+}
+
+static double run(bool coro, int connections, int rounds)
+{
+    Reactor reactor;
+    uint16_t port;
+    int listenFd = listenOnAnyPort(port);
+
+    AcceptCallback onAccept;
+    if (coro) {
+        onAccept = [&reactor](int fd) {
+            reactor.spawn(coroEchoSession(&reactor, fd));
+        };
+    }
+    reactor.registerHandler(std::make_shared<AcceptorHandler>(listenFd, &reactor, onAccept));
+
+    double seconds = 0;
+    std::thread client([&] {
+            std::vector<int> fds;
+            for (int i = 0; i < connections; i++) {
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                sockaddr_in addr{};
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                addr.sin_port = htons(port);
+                connect(fd, (sockaddr*)&addr, sizeof(addr));
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                fds.push_back(fd);
+            }
+
+            const char line[] = "ping\n";
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; r++) {
+                for (int fd : fds) {
+                    send(fd, line, sizeof(line) - 1, 0);
+                }
+                for (int fd : fds) {
+                    readReply(fd);
+                }
+            }
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for (int fd : fds) {
+                close(fd);
+            }
+            reactor.stop();
+            });
+
+    reactor.eventLoop();
+    client.join();
+    return double(connections) * rounds / seconds;
+}
+
+int main(int argc, char** argv)
+{
+    int connections = argc > 1 ? std::atoi(argv[1]) : 32;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    // Both servers log per event; keep that out of the measurement
+    std::cout.setstate(std::ios::badbit);
+    double callbacks = run(false, connections, rounds);
+    double coroutines = run(true, connections, rounds);
+    std::cout.clear();
+
+    std::cout << connections << " connections x " << rounds << " rounds\n"
+              << "ConnectionHandler (callbacks): " << callbacks << " round trips/s\n"
+              << "coroEchoSession (coroutines):  " << coroutines << " round trips/s" << std::endl;
+    return 0;
+}
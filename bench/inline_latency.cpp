@@ -0,0 +1,94 @@
+// Round-trip latency of submitTask through the worker pool versus the
+// inline path taken for tasks marked cheap. The pool path is measured
+// with workers that park right away and with spin-then-yield workers.
+//
+// One task is in flight at a time; each continuation records the time
+// since its submission and submits the next one.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Reactor.hpp"
+
+struct PingPong {
+    Reactor* reactor;
+    bool cheap;
+    int remaining;
+    std::vector<double> samples;
+    TaskClock::time_point submitted;
+
+    void next()
+    {
+        if (remaining-- == 0) {
+            reactor->stop();
+            return;
+        }
+        std::string message = "line " + std::to_string(remaining) + "\n";
+        submitted = TaskClock::now();
+
+        TaskOptions opts;
+        opts.cheap = cheap;
+        reactor->submitTask(
+                opts,
+                [message]() { return "Async " + message; },
+                [this](std::string) {
+                    samples.push_back(std::chrono::duration<double, std::nano>(
+                                TaskClock::now() - submitted).count());
+                    // Unwind before the next round trip so the inline path
+                    // does not recurse
+                    reactor->addTimer(0, false, [this] { next(); });
+                });
+    }
+};
+
+static void report(const char* name, std::vector<double>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double s : samples) {
+        sum += s;
+    }
+    auto pct = [&](double p) { return samples[size_t(p * (samples.size() - 1))]; };
+    std::cout << name
+              << "  mean=" << sum / samples.size()
+              << "ns  p50=" << pct(0.50)
+              << "ns  p99=" << pct(0.99)
+              << "ns  max=" << samples.back() << "ns" << std::endl;
+}
+
+static void reportTiers(Reactor& reactor)
+{
+    WorkerPoolStats stats = reactor.workerStats();
+    std::cout << "         picked up: busy=" << stats.pickedUp[int(IdleTier::Busy)]
+              << " spin=" << stats.pickedUp[int(IdleTier::Spin)]
+              << " yield=" << stats.pickedUp[int(IdleTier::Yield)]
+              << " park=" << stats.pickedUp[int(IdleTier::Park)] << std::endl;
+}
+
+static void measure(const char* name, Reactor& reactor, bool cheap, int iterations)
+{
+    PingPong run{&reactor, cheap, iterations, {}, {}};
+    run.samples.reserve(iterations);
+    reactor.addTimer(0, false, [&] { run.next(); });
+    reactor.eventLoop();
+    report(name, run.samples);
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 50000;
+
+    Reactor parking;
+    measure("offload (park)", parking, false, iterations);
+    reportTiers(parking);
+
+    Reactor spinning(2, IdleStrategy{20000, 100});
+    measure("offload (spin)", spinning, false, iterations);
+    reportTiers(spinning);
+
+    measure("inline        ", parking, true, iterations);
+
+    return 0;
+}
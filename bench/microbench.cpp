@@ -0,0 +1,365 @@
+// reactor_microbench: cost of the reactor's hot paths, printed as JSON so
+// runs on different commits can be diffed or plotted.
+//
+//     reactor_microbench [--repeat R] [--filter SUBSTRING] > before.json
+//
+// Every benchmark runs R times; the median and the minimum ns/op are
+// reported. The reactor-bound ones go through the public API the way
+// eventLoop uses the structures underneath:
+//   task_queue_*      TaskQueue push/tryPop, alone and with 2x2 threads
+//   timer_insert      Reactor::addTimer into TimerMap
+//   timer_cancel      Reactor::cancelTimer
+//   timer_expire      one processTimers pass firing every due timer
+//   handler_map_find  HandlerMap lookup as done per epoll event
+//   submit_round_trip submitTask -> worker -> continuation, one in flight
+//   submit_round_trip_traced  same with every task traced by TaskTracer
+//   completion_drain  processCompletedTasks per queued completion
+//   loop_profiler_lap one LoopProfiler sample, as taken per eventLoop phase
+//   http_parse        HttpParser on a 250-byte browser-like request
+//   kv_store_set/get  KvStore with 100k short keys, random access
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HttpParser.hpp"
+#include "KvStore.hpp"
+#include "Reactor.hpp"
+#include "TaskQueue.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    uint64_t opsPerRun;
+    std::vector<double> nsPerOp;
+};
+
+static double elapsedNs(Clock::time_point start, Clock::time_point end = Clock::now())
+{
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+static double taskQueueUncontended(int ops)
+{
+    TaskQueue queue;
+    Task out;
+    auto start = Clock::now();
+    for (int i = 0; i < ops; i++) {
+        Task t;
+        t.fn = [] {};
+        queue.push(std::move(t));
+        queue.tryPop(out);
+    }
+    return elapsedNs(start) / ops;
+}
+
+static double taskQueueContended(int ops)
+{
+    const int producers = 2;
+    const int consumers = 2;
+    TaskQueue queue;
+    std::atomic<int> popped{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&] {
+            while (!go) {}
+            for (int i = 0; i < ops / producers; i++) {
+                Task t;
+                t.fn = [] {};
+                queue.push(std::move(t));
+            }
+        });
+    }
+    for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&] {
+            while (!go) {}
+            Task out;
+            while (popped < ops) {
+                if (queue.tryPop(out)) {
+                    popped++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    auto start = Clock::now();
+    go = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    return elapsedNs(start) / ops;
+}
+
+static double timerInsert(Reactor& reactor, int ops, bool cancel)
+{
+    std::vector<int> ids(ops);
+    auto start = Clock::now();
+    for (int i = 0; i < ops; i++) {
+        // Spread over 64 buckets, far enough out that none fires
+        ids[i] = reactor.addTimer(60000 + i % 64, false, [] {});
+    }
+    double insertNs = elapsedNs(start) / ops;
+
+    start = Clock::now();
+    for (int id : ids) {
+        reactor.cancelTimer(id);
+    }
+    double cancelNs = elapsedNs(start) / ops;
+    return cancel ? cancelNs : insertNs;
+}
+
+static double timerExpire(Reactor& reactor, int ops)
+{
+    int fired = 0;
+    for (int i = 0; i < ops; i++) {
+        reactor.addTimer(0, false, [&fired] { fired++; });
+    }
+    reactor.addTimer(0, false, [&reactor] { reactor.stop(); });
+
+    auto start = Clock::now();
+    reactor.eventLoop();
+    double ns = elapsedNs(start) / ops;
+    if (fired != ops) {
+        std::cerr << "timer_expire: only " << fired << " of " << ops << " fired" << std::endl;
+    }
+    return ns;
+}
+
+class NullHandler : public EventHandler {
+    public:
+        explicit NullHandler(int fd) : fd_(fd) {}
+        int getHandle() const override { return fd_; }
+    private:
+        int fd_;
+};
+
+static double handlerMapFind(int ops)
+{
+    const int handlers = 1024;
+    HandlerMap map;
+    for (int fd = 0; fd < handlers; fd++) {
+        map[fd] = std::make_shared<NullHandler>(fd);
+    }
+
+    std::mt19937 rng(42);
+    std::vector<int> fds(4096);
+    for (int& fd : fds) {
+        fd = int(rng() % handlers);
+    }
+
+    size_t found = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < ops; i++) {
+        auto it = map.find(fds[i & (fds.size() - 1)]);
+        if (it != map.end()) {
+            found += it->second->getHandle() != 0;
+        }
+    }
+    double ns = elapsedNs(start) / ops;
+    if (found == 0) {
+        std::cerr << "handler_map_find: nothing found" << std::endl;
+    }
+    return ns;
+}
+
+struct PingPong {
+    Reactor* reactor;
+    int remaining;
+
+    void next()
+    {
+        if (remaining-- == 0) {
+            reactor->stop();
+            return;
+        }
+        reactor->submitTask([]() { return 1; }, [this](int) { next(); });
+    }
+};
+
+static double submitRoundTrip(Reactor& reactor, int ops)
+{
+    PingPong run{&reactor, ops};
+    auto start = Clock::now();
+    run.next();
+    reactor.eventLoop();
+    return elapsedNs(start) / ops;
+}
+
+static double completionDrain(Reactor& reactor, int ops)
+{
+    int done = 0;
+    Clock::time_point queued;
+    Clock::time_point drained;
+
+    // Submits from inside a callback and holds the reactor until the
+    // workers have run everything, so all completions are queued when
+    // the next loop iteration drains them
+    reactor.addTimer(0, false, [&] {
+        uint64_t before = reactor.workerStats().executed;
+        for (int i = 0; i < ops; i++) {
+            reactor.submitTask([]() { return 1; }, [&](int) {
+                if (++done == ops) {
+                    drained = Clock::now();
+                    reactor.stop();
+                }
+            });
+        }
+        while (reactor.workerStats().executed < before + ops) {
+            std::this_thread::yield();
+        }
+        queued = Clock::now();
+    });
+    reactor.eventLoop();
+    return elapsedNs(queued, drained) / ops;
+}
+
+static double loopProfilerLap(int ops)
+{
+    LoopProfiler profiler;
+    profiler.enable(true);
+    uint64_t mark = profiler.mark();
+    auto start = Clock::now();
+    for (int i = 0; i < ops; i++) {
+        mark = profiler.lap(LoopPhase::Dispatch, mark);
+    }
+    return elapsedNs(start) / ops;
+}
+
+static double httpParse(int ops)
+{
+    static const char request[] =
+        "GET /search?q=reactor&page=2 HTTP/1.1\r\n"
+        "Host: localhost:9000\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+        "Accept: text/html,application/xhtml+xml\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    HttpParser parser;
+    HttpRequest req;
+    size_t parsed = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < ops; i++) {
+        parsed += parser.parse(request, sizeof(request) - 1, req) == HttpParser::Status::Complete;
+        parser.reset();
+    }
+    double ns = elapsedNs(start) / ops;
+    if (parsed != size_t(ops)) {
+        std::cerr << "http_parse: " << parsed << " of " << ops << " parsed" << std::endl;
+    }
+    return ns;
+}
+
+static double kvStore(Reactor& reactor, int ops, bool set)
+{
+    const int keys = 100000;
+    KvStore store(&reactor);
+    std::vector<std::string> names(keys);
+    for (int i = 0; i < keys; i++) {
+        names[i] = "user:" + std::to_string(i);
+        store.set(names[i], "some value");
+    }
+
+    std::mt19937 rng(7);
+    std::vector<int> order(4096);
+    for (int& k : order) {
+        k = int(rng() % keys);
+    }
+
+    size_t found = 0;
+    std::string_view value;
+    auto start = Clock::now();
+    for (int i = 0; i < ops; i++) {
+        const std::string& key = names[order[i & (order.size() - 1)]];
+        if (set) {
+            store.set(key, "other value");
+        } else {
+            found += store.get(key, value);
+        }
+    }
+    double ns = elapsedNs(start) / ops;
+    if (!set && found != size_t(ops)) {
+        std::cerr << "kv_store_get: " << found << " of " << ops << " found" << std::endl;
+    }
+    return ns;
+}
+
+template<typename Fn>
+static Result measure(const std::string& name, uint64_t ops, int repeat, Fn fn)
+{
+    Result r{name, ops, {}};
+    fn();
+    for (int i = 0; i < repeat; i++) {
+        r.nsPerOp.push_back(fn());
+    }
+    std::sort(r.nsPerOp.begin(), r.nsPerOp.end());
+    return r;
+}
+
+int main(int argc, char** argv)
+{
+    int repeat = 5;
+    std::string filter;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--repeat") {
+            repeat = std::max(1, std::atoi(argv[i + 1]));
+        } else if (arg == "--filter") {
+            filter = argv[i + 1];
+        }
+    }
+
+    Reactor reactor;
+    std::vector<Result> results;
+    auto add = [&](const std::string& name, int ops, auto fn) {
+        if (name.find(filter) != std::string::npos) {
+            results.push_back(measure(name, ops, repeat, [&] { return fn(ops); }));
+        }
+    };
+
+    add("task_queue_uncontended", 1000000, taskQueueUncontended);
+    add("task_queue_contended_2x2", 200000, taskQueueContended);
+    add("timer_insert", 20000, [&](int ops) { return timerInsert(reactor, ops, false); });
+    add("timer_cancel", 20000, [&](int ops) { return timerInsert(reactor, ops, true); });
+    add("timer_expire", 100000, [&](int ops) { return timerExpire(reactor, ops); });
+    add("handler_map_find", 10000000, handlerMapFind);
+    add("submit_round_trip", 50000, [&](int ops) { return submitRoundTrip(reactor, ops); });
+    add("submit_round_trip_traced", 50000, [&](int ops) {
+        reactor.setTaskTracing(1);
+        double ns = submitRoundTrip(reactor, ops);
+        reactor.setTaskTracing(0);
+        return ns;
+    });
+    add("completion_drain", 100000, [&](int ops) { return completionDrain(reactor, ops); });
+    add("loop_profiler_lap", 10000000, loopProfilerLap);
+    add("http_parse", 1000000, httpParse);
+    add("kv_store_set", 1000000, [&](int ops) { return kvStore(reactor, ops, true); });
+    add("kv_store_get", 1000000, [&](int ops) { return kvStore(reactor, ops, false); });
+
+    std::cout << "{\n"
+              << "  \"timestamp\": " << std::time(nullptr) << ",\n"
+              << "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n"
+              << "  \"repeat\": " << repeat << ",\n"
+              << "  \"phase_clock\": \"" << (PhaseClock::usesTsc() ? "tsc" : "monotonic_raw") << "\",\n"
+              << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        std::cout << (i ? ",\n" : "\n")
+                  << "    {\"name\": \"" << r.name << "\""
+                  << ", \"ops\": " << r.opsPerRun
+                  << ", \"ns_per_op_median\": " << r.nsPerOp[r.nsPerOp.size() / 2]
+                  << ", \"ns_per_op_min\": " << r.nsPerOp.front() << "}";
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,307 @@
+// Broadcast fan-out to N subscribers (10000 by default): one copy and one
+// send per recipient per message, as the MUD guide's broadcastToRoom does,
+// against PubSub handing one SharedBuffer to every PubSubConnectionHandler
+// and flushing each subscriber once per loop iteration with a gather
+// write.
+//
+// Memory: heap held per queued message while it waits on all N queues.
+// Throughput: a forked reader process holds the other ends of the N
+// connections (one process could not open both within RLIMIT_NOFILE),
+// reads everything and acknowledges each burst of B messages over a
+// pipe, which starts the next one.
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "AcceptorHandler.hpp"
+#include "PubSubConnectionHandler.hpp"
+#include "Reactor.hpp"
+
+// Live heap bytes, by usable size. Every form of new and delete that the
+// library implements on top of malloc is replaced, so no pointer crosses
+// from a counted allocation to an uncounted free or back; the nothrow
+// forms call these, the aligned ones never mix with them.
+static std::atomic<int64_t> heapBytes{0};
+
+static void* countedAlloc(std::size_t size)
+{
+    if (void* p = std::malloc(size ? size : 1)) {
+        heapBytes.fetch_add(int64_t(malloc_usable_size(p)), std::memory_order_relaxed);
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+static void countedFree(void* p) noexcept
+{
+    if (p) {
+        heapBytes.fetch_sub(int64_t(malloc_usable_size(p)), std::memory_order_relaxed);
+    }
+    std::free(p);
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { countedFree(p); }
+
+static int listenOnAnyPort(uint16_t& port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4096) < 0) {
+        perror("bind/listen");
+        exit(1);
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// Queues like a connection would, without a socket to flush to
+struct QueueSubscriber : Subscriber
+{
+    OutputQueue queue;
+    void deliver(const SharedBuffer& message) override { queue.append(message); }
+    void flushDeliveries() override {}
+};
+
+// The per-recipient copy of a broadcast loop
+struct CopySubscriber : Subscriber
+{
+    std::string output;
+    void deliver(const SharedBuffer& message) override { output.append(message.view()); }
+    void flushDeliveries() override {}
+};
+
+// Heap bytes per message while count messages of size bytes wait on
+// every subscriber's queue
+template<typename S>
+static double heapPerMessage(size_t subscribers, size_t size, size_t count)
+{
+    PubSub pubsub;
+    std::vector<S> subs(subscribers);
+    for (S& s : subs) {
+        pubsub.subscribe("bench", &s);
+    }
+    std::string message(size, 'm');
+
+    int64_t before = heapBytes.load();
+    for (size_t i = 0; i < count; i++) {
+        pubsub.publish("bench", std::string_view(message));
+    }
+    int64_t after = heapBytes.load();
+
+    for (S& s : subs) {
+        pubsub.unsubscribeAll(&s);
+    }
+    return double(after - before) / count;
+}
+
+// Reader side: connects n times, reads everything and writes one byte to
+// ack for every burstBytes bytes received in total over all connections
+static void readerProcess(uint16_t port, size_t n, size_t burstBytes, size_t bursts, int ack)
+{
+    int epollFd = epoll_create1(0);
+    for (size_t i = 0; i < n; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            perror("reader connect");
+            _exit(1);
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    std::vector<char> buffer(1 << 16);
+    epoll_event events[256];
+    size_t received = 0;
+    size_t acked = 0;
+    while (acked < bursts) {
+        int ready = epoll_wait(epollFd, events, 256, -1);
+        for (int i = 0; i < ready; i++) {
+            ssize_t got;
+            while ((got = recv(events[i].data.fd, buffer.data(), buffer.size(), 0)) > 0) {
+                received += got;
+            }
+        }
+        while (received >= (acked + 1) * burstBytes) {
+            char c = 1;
+            write(ack, &c, 1);
+            acked++;
+        }
+    }
+    _exit(0);
+}
+
+// Publishes the next burst whenever the reader acknowledges one
+class BurstDriver : public EventHandler
+{
+    public:
+        BurstDriver(int fd, Reactor* reactor, size_t subscribers, size_t burst,
+                    size_t bursts, size_t messageSize)
+            : fd_(fd), reactor_(reactor), subscribers_(subscribers), burst_(burst),
+              bursts_(bursts), message_(messageSize - 1, 'b')
+        {
+            message_ += '\n';
+        }
+
+        int getHandle() const override { return fd_; }
+
+        void addSubscriber(int fd)
+        {
+            fds_.push_back(fd);
+            if (fds_.size() == subscribers_) {
+                next();
+            }
+        }
+
+        void handleRead() override
+        {
+            char acks[64];
+            ssize_t n;
+            while ((n = read(fd_, acks, sizeof(acks))) > 0) {
+                for (ssize_t i = 0; i < n; i++) {
+                    next();
+                }
+            }
+        }
+
+        double copyRate = 0;
+        double sharedRate = 0;
+        size_t shortSends = 0;
+
+    private:
+        int fd_;
+        Reactor* reactor_;
+        size_t subscribers_;
+        size_t burst_;
+        size_t bursts_;
+        std::string message_;
+        std::vector<int> fds_;
+        size_t done_ = 0;
+        std::chrono::steady_clock::time_point start_;
+
+        void next()
+        {
+            // Copies first, then the same number of shared bursts
+            if (done_ == 0 || done_ == bursts_) {
+                auto now = std::chrono::steady_clock::now();
+                if (done_ == bursts_) {
+                    copyRate = rate(now);
+                }
+                start_ = now;
+            }
+            if (done_ == 2 * bursts_) {
+                sharedRate = rate(std::chrono::steady_clock::now());
+                reactor_->stop();
+                return;
+            }
+
+            bool copy = done_ < bursts_;
+            done_++;
+            for (size_t m = 0; m < burst_; m++) {
+                if (copy) {
+                    for (int fd : fds_) {
+                        std::string line = message_;
+                        if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != ssize_t(line.size())) {
+                            shortSends++;
+                        }
+                    }
+                } else {
+                    reactor_->pubsub().publish("bench", std::string_view(message_));
+                }
+            }
+        }
+
+        double rate(std::chrono::steady_clock::time_point now) const
+        {
+            double seconds = std::chrono::duration<double>(now - start_).count();
+            return double(bursts_ * burst_) / seconds;
+        }
+};
+
+int main(int argc, char** argv)
+{
+    size_t subscribers = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+    size_t messageSize = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+    size_t burst = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 16;
+    size_t bursts = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 5;
+
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (subscribers + 64 > limit.rlim_cur) {
+        subscribers = limit.rlim_cur - 64;
+    }
+
+    std::cout << subscribers << " subscribers, " << messageSize << "-byte messages\n";
+    std::cout << "heap per queued message: copy per recipient "
+              << heapPerMessage<CopySubscriber>(subscribers, messageSize, 64) << " B, shared buffer "
+              << heapPerMessage<QueueSubscriber>(subscribers, messageSize, 64) << " B" << std::endl;
+
+    uint16_t port;
+    int listenFd = listenOnAnyPort(port);
+    int ack[2];
+    if (pipe2(ack, O_NONBLOCK) < 0) {
+        perror("pipe2");
+        return 1;
+    }
+    pid_t reader = fork();
+    if (reader == 0) {
+        close(listenFd);
+        close(ack[0]);
+        readerProcess(port, subscribers, burst * messageSize * subscribers, 2 * bursts, ack[1]);
+    }
+    close(ack[1]);
+
+    // The server logs per connection; keep that out of the measurement
+    std::cout.setstate(std::ios::badbit);
+    Reactor reactor;
+    auto driver = std::make_shared<BurstDriver>(ack[0], &reactor, subscribers, burst, bursts, messageSize);
+    reactor.registerHandler(driver);
+    reactor.registerHandler(std::make_shared<AcceptorHandler>(listenFd, &reactor, [&reactor, &driver](int fd) {
+            auto conn = std::make_shared<PubSubConnectionHandler>(fd, &reactor);
+            reactor.registerHandler(conn, EPOLLIN | EPOLLOUT | EPOLLET);
+            reactor.pubsub().subscribe("bench", conn.get());
+            driver->addSubscriber(fd);
+            }));
+    reactor.eventLoop();
+    std::cout.clear();
+    waitpid(reader, nullptr, 0);
+
+    std::cout << "bursts of " << burst << ", " << bursts << " bursts each\n"
+              << "copy + send per recipient: " << driver->copyRate << " msgs/s ("
+              << driver->copyRate * subscribers << " deliveries/s)\n"
+              << "shared buffer + writev:    " << driver->sharedRate << " msgs/s ("
+              << driver->sharedRate * subscribers << " deliveries/s)" << std::endl;
+    if (driver->shortSends > 0) {
+        std::cout << "warning: " << driver->shortSends << " short sends in the copy run" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Counts heap allocations per submitTask round trip, and per
+// co_await asyncWork() from a coroutine.
+//
+// Each continuation submits the next task, so exactly one task is in
+// flight and every allocation between start and stop belongs to the
+// round trips being measured. The result type is move-only on purpose.
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include "AsyncWork.hpp"
+#include "Reactor.hpp"
+
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Move-only and allocation-free, so every counted allocation is overhead
+struct Payload {
+    explicit Payload(int v) : value(v) {}
+    Payload(Payload&&) = default;
+    Payload(const Payload&) = delete;
+    int value;
+};
+
+struct RoundTrip {
+    Reactor* reactor;
+    int remaining;
+    uint64_t sum = 0;
+
+    void next()
+    {
+        if (remaining-- == 0) {
+            reactor->stop();
+            return;
+        }
+        int n = remaining;
+        reactor->submitTask(
+                [n]() { return Payload(n); },
+                [this](Payload v) {
+                    sum += v.value;
+                    next();
+                });
+    }
+};
+
+// Same round trips as a coroutine: the frame is allocated once by the
+// call, each co_await itself should not allocate
+static CoroTask<void> awaitLoop(Reactor& reactor, int iterations, uint64_t& before,
+                                uint64_t& after, uint64_t& sum)
+{
+    // Warm up the queues first
+    for (int i = 0; i < 1000; i++) {
+        sum += (co_await asyncWork(reactor, [i]() { return Payload(i); })).value;
+    }
+
+    before = allocations.load();
+    for (int i = 0; i < iterations; i++) {
+        sum += (co_await asyncWork(reactor, [i]() { return Payload(i); })).value;
+    }
+    after = allocations.load();
+    reactor.stop();
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    Reactor reactor;
+
+    // Warm up so the queues reach their steady-state capacity
+    RoundTrip warmup{&reactor, 1000};
+    reactor.addTimer(0, false, [&] { warmup.next(); });
+    reactor.eventLoop();
+
+    RoundTrip trip{&reactor, iterations};
+    uint64_t before = 0;
+    auto start = std::chrono::steady_clock::now();
+    reactor.addTimer(0, false, [&] {
+            before = allocations.load();
+            start = std::chrono::steady_clock::now();
+            trip.next();
+            });
+    reactor.eventLoop();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    uint64_t count = allocations.load() - before;
+
+    // Exceptions reach a continuation that takes TaskResult<T>
+    bool propagated = false;
+    Reactor failing;
+    failing.addTimer(0, false, [&] {
+            failing.submitTask(
+                    []() -> int { throw std::runtime_error("boom"); },
+                    [&](TaskResult<int> r) {
+                        try {
+                            r.get();
+                        } catch (const std::runtime_error&) {
+                            propagated = true;
+                        }
+                        failing.stop();
+                    });
+            });
+    failing.eventLoop();
+
+    uint64_t awaitBefore = 0;
+    uint64_t awaitAfter = 0;
+    uint64_t awaitSum = 0;
+    reactor.spawn(awaitLoop(reactor, iterations, awaitBefore, awaitAfter, awaitSum));
+    reactor.eventLoop();
+
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    std::cout << "round trips:          " << iterations << "\n"
+              << "allocations/trip:     " << double(count) / iterations << "\n"
+              << "allocations/await:    " << double(awaitAfter - awaitBefore) / iterations << "\n"
+              << "latency/trip (ns):    " << ns / iterations << "\n"
+              << "exception propagated: " << (propagated ? "yes" : "no") << std::endl;
+
+    return propagated ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+// WebSocket payload unmasking and echo throughput.
+//
+// First every unmask kernel the CPU supports runs over payloads from a
+// small chat message to a 64 KiB frame. Then one client streams masked
+// frames at a WebSocketConnectionHandler that echoes them, from one
+// thread while another reads the echoes, for small and large frames.
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include "AcceptorHandler.hpp"
+#include "Reactor.hpp"
+#include "WebSocketConnectionHandler.hpp"
+
+static int listenOnAnyPort(uint16_t& port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1024) < 0) {
+        perror("bind/listen");
+        exit(1);
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static const char* kernelName(UnmaskKernel kernel)
+{
+    switch (kernel) {
+        case UnmaskKernel::Scalar:
+            return "scalar";
+        case UnmaskKernel::Sse2:
+            return "sse2";
+        case UnmaskKernel::Avx2:
+            return "avx2";
+    }
+    return "?";
+}
+
+// GB/s of one kernel unmasking size-byte payloads, about 256 MiB in all
+static double unmaskRate(UnmaskKernel kernel, size_t size)
+{
+    std::vector<char> payload(size, 'x');
+    size_t iterations = (size_t(256) << 20) / size;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        unmaskWs(payload.data(), size, 0x37fa213d, i, kernel);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return double(iterations) * size / seconds / 1e9;
+}
+
+static std::string maskedFrame(WsOpcode opcode, size_t size)
+{
+    std::string payload(size, 'w');
+    std::string frame;
+    appendWsFrame(frame, opcode, payload);
+    // Set the mask bit and splice the key in after the length
+    size_t header = frame.size() - size;
+    frame[1] = char(uint8_t(frame[1]) | 0x80);
+    uint32_t key = 0x9c1e02b5;
+    frame.insert(header, reinterpret_cast<const char*>(&key), 4);
+    unmaskWs(frame.data() + header + 4, size, key, 0);
+    return frame;
+}
+
+static bool readExactly(int fd, char* buffer, size_t len)
+{
+    for (size_t got = 0; got < len;) {
+        ssize_t n = recv(fd, buffer + got, len - got, 0);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+// Messages per second echoed for count frames of size bytes
+static double echoRate(size_t size, size_t count)
+{
+    Reactor reactor;
+    uint16_t port;
+    int listenFd = listenOnAnyPort(port);
+    reactor.registerHandler(std::make_shared<AcceptorHandler>(listenFd, &reactor, [&reactor](int fd) {
+            auto echo = [](WebSocketConnectionHandler& conn, std::string_view message, bool binary) {
+                conn.send(message, binary);
+            };
+            reactor.registerHandler(std::make_shared<WebSocketConnectionHandler>(fd, &reactor, echo),
+                                    EPOLLIN | EPOLLOUT | EPOLLET);
+            }));
+
+    double seconds = 0;
+    std::thread client([&] {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(port);
+            connect(fd, (sockaddr*)&addr, sizeof(addr));
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            std::string upgrade = "GET / HTTP/1.1\r\nHost: bench\r\nUpgrade: websocket\r\n"
+                "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                "Sec-WebSocket-Version: 13\r\n\r\n";
+            send(fd, upgrade.data(), upgrade.size(), 0);
+            std::string head;
+            char c;
+            while (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0) {
+                if (recv(fd, &c, 1, 0) != 1) {
+                    exit(1);
+                }
+                head += c;
+            }
+
+            // Batches of up to 64 KiB, so small frames share sends
+            std::string frame = maskedFrame(WsOpcode::Binary, size);
+            size_t perBatch = std::max<size_t>(1, 65536 / frame.size());
+            std::string batch;
+            for (size_t i = 0; i < perBatch; i++) {
+                batch += frame;
+            }
+            size_t echoSize = frame.size() - 4;
+
+            auto start = std::chrono::steady_clock::now();
+            std::thread writer([&] {
+                    for (size_t sent = 0; sent < count; sent += perBatch) {
+                        size_t n = std::min(perBatch, count - sent) * frame.size();
+                        send(fd, batch.data(), n, 0);
+                    }
+                    });
+            std::vector<char> in(1 << 20);
+            for (size_t left = count * echoSize; left > 0;) {
+                size_t n = std::min(left, in.size());
+                if (!readExactly(fd, in.data(), n)) {
+                    break;
+                }
+                left -= n;
+            }
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            writer.join();
+
+            close(fd);
+            reactor.stop();
+            });
+
+    reactor.eventLoop();
+    client.join();
+    return double(count) / seconds;
+}
+
+int main(int argc, char** argv)
+{
+    size_t smallFrames = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t largeFrames = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8000;
+
+    std::cout << "unmask GB/s      16 B    125 B    1 KiB   64 KiB\n";
+    for (UnmaskKernel kernel : {UnmaskKernel::Scalar, UnmaskKernel::Sse2, UnmaskKernel::Avx2}) {
+        if (!unmaskKernelSupported(kernel)) {
+            continue;
+        }
+        std::cout.width(8);
+        std::cout << std::left << kernelName(kernel) << std::right;
+        for (size_t size : {16, 125, 1024, 65536}) {
+            std::cout.width(9);
+            std::cout.precision(2);
+            std::cout << std::fixed << unmaskRate(kernel, size);
+        }
+        std::cout << "\n";
+    }
+
+    // The server logs per event; keep that out of the measurement
+    std::cout.setstate(std::ios::badbit);
+    double small = echoRate(32, smallFrames);
+    double large = echoRate(65536, largeFrames);
+    std::cout.clear();
+
+    std::cout.precision(0);
+    std::cout << "echo 32 B frames:   " << small << " msgs/s, " << small * 32 / 1e6 << " MB/s\n"
+              << "echo 64 KiB frames: " << large << " msgs/s, " << large * 65536 / 1e6 << " MB/s"
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Cost of joining four worker jobs with whenAll versus awaiting them one
+// after another with asyncWork, and of whenAny.
+//
+// Run once with empty jobs (pure coordination overhead) and once with
+// jobs that spin for a few microseconds, where whenAll can overlap them
+// if the machine has the cores.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include "AsyncWork.hpp"
+#include "Reactor.hpp"
+#include "WhenAll.hpp"
+#include "WhenAny.hpp"
+
+static int spin(int us)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    int n = 0;
+    while (std::chrono::steady_clock::now() < until) {
+        n++;
+    }
+    return n;
+}
+
+struct Timings {
+    double sequential;
+    double all;
+    double any;
+};
+
+static CoroTask<void> measure(Reactor& reactor, int iterations, int workUs, Timings& out)
+{
+    auto job = [workUs]() { return spin(workUs); };
+    using Clock = std::chrono::steady_clock;
+    long sink = 0;
+
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        sink += co_await asyncWork(reactor, job);
+        sink += co_await asyncWork(reactor, job);
+        sink += co_await asyncWork(reactor, job);
+        sink += co_await asyncWork(reactor, job);
+    }
+    out.sequential = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+
+    start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        auto [a, b, c, d] = co_await whenAll(reactor, job, job, job, job);
+        sink += a + b + c + d;
+    }
+    out.all = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+
+    start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        auto first = co_await whenAny(reactor, job, job, job, job);
+        sink += first.value;
+    }
+    out.any = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+
+    if (sink < 0) {
+        std::cerr << "impossible" << std::endl;
+    }
+    reactor.stop();
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20000;
+    Reactor reactor(4);
+
+    for (int workUs : {0, 20}) {
+        Timings t{};
+        reactor.spawn(measure(reactor, iterations, workUs, t));
+        reactor.eventLoop();
+        std::cout << "4 jobs of " << workUs << "us:"
+                  << "  sequential awaits=" << t.sequential << "ns"
+                  << "  whenAll=" << t.all << "ns"
+                  << "  whenAny=" << t.any << "ns" << std::endl;
+    }
+    return 0;
+}
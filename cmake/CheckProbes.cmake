@@ -0,0 +1,20 @@
+# Fails unless BINARY carries every reactor USDT probe with a semaphore:
+#   cmake -DREADELF=readelf -DBINARY=react1 -P CheckProbes.cmake
+set(probes accept recv conn__close handler__remove task__submit task__complete timer__fire)
+
+execute_process(COMMAND ${READELF} -n ${BINARY} OUTPUT_VARIABLE notes RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${READELF} -n ${BINARY} failed")
+endif()
+
+foreach(probe IN LISTS probes)
+    string(REGEX MATCH "Provider: reactor\n[ ]*Name: ${probe}\n[^\n]*Semaphore: (0x[0-9a-f]+)" found "${notes}")
+    if(NOT found)
+        message(FATAL_ERROR "${BINARY}: no reactor:${probe} in .note.stapsdt")
+    endif()
+    if(CMAKE_MATCH_1 MATCHES "^0x0+$")
+        message(FATAL_ERROR "${BINARY}: reactor:${probe} has no semaphore")
+    endif()
+endforeach()
+list(LENGTH probes count)
+message(STATUS "${BINARY}: ${count} reactor USDT probes")
@@ -1,13 +1,18 @@
 #ifndef ACCEPTOR_HANDLER_H
 #define ACCEPTOR_HANDLER_H
 
+#include <functional>
 #include "EventHandler.hpp"
 #include "Reactor.hpp"
 
+// Called with each accepted, non-blocking client fd
+using AcceptCallback = std::function<void(int fd)>;
+
 class AcceptorHandler : public EventHandler {
     public:
-        AcceptorHandler(int fd, Reactor* reactor)
-            : fd_(fd), reactor_(reactor) {}
+        // Without a callback every client gets a ConnectionHandler
+        AcceptorHandler(int fd, Reactor* reactor, AcceptCallback onAccept = {})
+            : fd_(fd), reactor_(reactor), onAccept_(std::move(onAccept)) {}
 
         int getHandle() const override { return fd_; }
 
@@ -16,6 +21,7 @@ class AcceptorHandler : public EventHandler {
     private:
         int fd_;
         Reactor* reactor_;
+        AcceptCallback onAccept_;
         void makeNonBlocking(int fd);
 };
 
@@ -0,0 +1,132 @@
+#ifndef ASYNC_GENERATOR_H
+#define ASYNC_GENERATOR_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "CancelScope.hpp"
+#include "FramePool.hpp"
+
+// Coroutine producing a sequence of T, one value per request, that may
+// co_await between values. C++20 has no `for co_await`, so consumers
+// pull with next():
+//
+//     auto lines = conn.lines();
+//     while (auto line = co_await lines.next()) { ... *line ... }
+//
+// The generator only runs while a next() is pending, so a producer that
+// reads from a socket stops reading when the consumer stops asking.
+// Control passes between the two by symmetric transfer; frames come
+// from the reactor's FramePool like CoroTask's.
+template<typename T>
+class AsyncGenerator
+{
+    public:
+        struct promise_type
+        {
+            std::optional<T> current;
+            std::coroutine_handle<> consumer;
+            std::exception_ptr exception;
+            // Inherited from the consumer on each next()
+            CancelScope* cancelScope = nullptr;
+
+            AsyncGenerator get_return_object()
+            {
+                return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            // Hands the value to the consumer and suspends until the next
+            // next(); final_suspend does the same with no value
+            struct ToConsumer
+            {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                {
+                    return h.promise().consumer;
+                }
+                void await_resume() noexcept {}
+            };
+
+            ToConsumer yield_value(T value)
+            {
+                current.emplace(std::move(value));
+                return {};
+            }
+
+            ToConsumer final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { exception = std::current_exception(); }
+
+            static void* operator new(std::size_t size) { return FramePool::allocateFrame(size); }
+            static void operator delete(void* frame, std::size_t size) { FramePool::freeFrame(frame, size); }
+        };
+
+        using Handle = std::coroutine_handle<promise_type>;
+
+        explicit AsyncGenerator(Handle h) : coro_(h) {}
+        AsyncGenerator(AsyncGenerator&& other) noexcept : coro_(std::exchange(other.coro_, {})) {}
+        AsyncGenerator& operator=(AsyncGenerator&& other) noexcept
+        {
+            if (this != &other) {
+                if (coro_) {
+                    coro_.destroy();
+                }
+                coro_ = std::exchange(other.coro_, {});
+            }
+            return *this;
+        }
+        AsyncGenerator(const AsyncGenerator&) = delete;
+        AsyncGenerator& operator=(const AsyncGenerator&) = delete;
+
+        ~AsyncGenerator()
+        {
+            if (coro_) {
+                coro_.destroy();
+            }
+        }
+
+        struct NextAwaiter
+        {
+            Handle coro;
+
+            bool await_ready() const noexcept { return !coro || coro.done(); }
+
+            template<typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> consumer) noexcept
+                {
+                    auto& p = coro.promise();
+                    p.current.reset();
+                    p.consumer = consumer;
+                    if constexpr (requires { consumer.promise().cancelScope; }) {
+                        p.cancelScope = consumer.promise().cancelScope;
+                    }
+                    return coro;
+                }
+
+            // The next value, or nullopt once the generator has finished
+            std::optional<T> await_resume()
+            {
+                if (!coro) {
+                    return std::nullopt;
+                }
+                auto& p = coro.promise();
+                if (p.exception) {
+                    std::rethrow_exception(std::exchange(p.exception, nullptr));
+                }
+                if (coro.done()) {
+                    return std::nullopt;
+                }
+                return std::move(p.current);
+            }
+        };
+
+        NextAwaiter next() { return NextAwaiter{coro_}; }
+
+    private:
+        Handle coro_;
+};
+
+#endif
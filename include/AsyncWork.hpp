@@ -0,0 +1,99 @@
+#ifndef ASYNC_WORK_H
+#define ASYNC_WORK_H
+
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+#include "Completion.hpp"
+#include "Reactor.hpp"
+#include "Task.hpp"
+
+// Awaitable that runs fn on a worker and resumes the awaiting coroutine on
+// the reactor thread with its result:
+//
+//     std::string reply = co_await asyncWork(reactor, [msg] { return "Async " + msg; });
+//
+// The awaiter lives in the coroutine frame and is the only state: the
+// worker gets a pointer to it and the reactor is handed back the bare
+// coroutine_handle, so a round trip allocates nothing. Exceptions thrown
+// by fn are rethrown from co_await. TaskOptions apply as for submitTask;
+// a dropped task resumes with OperationCancelled or DeadlineExceeded.
+template<typename Fn>
+class AsyncWork
+{
+    public:
+        using Result = std::remove_cvref_t<std::invoke_result_t<Fn&>>;
+
+        template<typename F>
+            AsyncWork(Reactor& reactor, F&& fn, TaskOptions opts)
+            : reactor_(reactor), fn_(std::forward<F>(fn)), opts_(std::move(opts)) {}
+
+        bool await_ready()
+        {
+            if (!opts_.cheap) {
+                return false;
+            }
+            // Cheaper than the round trip: run it right here
+            if (opts_.deadline != TaskClock::time_point::max() && opts_.deadline < TaskClock::now()) {
+                result_.setError(std::make_exception_ptr(DeadlineExceeded()));
+            } else if (opts_.cancel.isCancelled()) {
+                result_.setError(std::make_exception_ptr(OperationCancelled()));
+            } else {
+                execute();
+            }
+            return true;
+        }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            continuation_ = h;
+
+            Task task;
+            task.fn = [this]() {
+                execute();
+                reactor_.resumeOnReactor(continuation_);
+            };
+            task.onDrop = [this](DropReason reason) {
+                if (reason == DropReason::DeadlineMissed) {
+                    result_.setError(std::make_exception_ptr(DeadlineExceeded()));
+                } else {
+                    result_.setError(std::make_exception_ptr(OperationCancelled()));
+                }
+                reactor_.resumeOnReactor(continuation_);
+            };
+            task.cancel = opts_.cancel;
+            task.deadline = opts_.deadline;
+            reactor_.postToWorkers(std::move(task));
+        }
+
+        Result await_resume() { return result_.get(); }
+
+    private:
+        void execute()
+        {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    fn_();
+                    result_.setValue();
+                } else {
+                    result_.setValue(fn_());
+                }
+            } catch (...) {
+                result_.setError(std::current_exception());
+            }
+        }
+
+        Reactor& reactor_;
+        Fn fn_;
+        TaskOptions opts_;
+        TaskResult<Result> result_;
+        std::coroutine_handle<> continuation_;
+};
+
+template<typename Fn>
+AsyncWork<std::decay_t<Fn>> asyncWork(Reactor& reactor, Fn&& fn, TaskOptions opts = TaskOptions{})
+{
+    return AsyncWork<std::decay_t<Fn>>(reactor, std::forward<Fn>(fn), std::move(opts));
+}
+
+#endif
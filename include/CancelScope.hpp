@@ -0,0 +1,51 @@
+#ifndef CANCEL_SCOPE_H
+#define CANCEL_SCOPE_H
+
+#include <utility>
+
+// Cancellation for a chain of coroutines awaiting one another on the
+// reactor thread (withTimeout, for one). Awaiting a CoroTask passes the
+// scope down the chain; the awaiter the chain is currently suspended in
+// arms the scope with a way to wake it, and request() calls that so the
+// awaiter resumes with OperationCancelled.
+//
+// Unlike CancellationToken this is not thread-safe: it is only touched
+// by the reactor thread and costs two pointer writes per suspension.
+class CancelScope
+{
+    public:
+        using Canceller = void (*)(void* ctx);
+
+        bool requested() const { return requested_; }
+
+        void request()
+        {
+            requested_ = true;
+            // The woken coroutine may finish and free this scope, so take
+            // what we need before calling it
+            Canceller fn = std::exchange(fn_, nullptr);
+            void* ctx = std::exchange(ctx_, nullptr);
+            if (fn) {
+                fn(ctx);
+            }
+        }
+
+        void arm(Canceller fn, void* ctx)
+        {
+            fn_ = fn;
+            ctx_ = ctx;
+        }
+
+        void disarm()
+        {
+            fn_ = nullptr;
+            ctx_ = nullptr;
+        }
+
+    private:
+        bool requested_ = false;
+        Canceller fn_ = nullptr;
+        void* ctx_ = nullptr;
+};
+
+#endif
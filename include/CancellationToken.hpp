@@ -0,0 +1,41 @@
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+#include <atomic>
+#include <memory>
+
+// Read side of a cancellation flag. Cheap to copy (one shared_ptr), safe
+// to check from any thread. A default-constructed token is never cancelled.
+class CancellationToken
+{
+    public:
+        CancellationToken() = default;
+        explicit CancellationToken(std::shared_ptr<std::atomic<bool>> state)
+            : state_(std::move(state)) {}
+
+        bool isCancelled() const
+        {
+            return state_ && state_->load(std::memory_order_acquire);
+        }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> state_;
+};
+
+// Owner side: whoever controls the lifetime of the work (a connection,
+// usually) cancels it and every token handed out sees the change.
+class CancellationSource
+{
+    public:
+        CancellationSource()
+            : state_(std::make_shared<std::atomic<bool>>(false)) {}
+
+        CancellationToken token() const { return CancellationToken(state_); }
+        void cancel() { state_->store(true, std::memory_order_release); }
+        bool isCancelled() const { return state_->load(std::memory_order_acquire); }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> state_;
+};
+
+#endif
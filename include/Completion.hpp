@@ -0,0 +1,188 @@
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "CancellationToken.hpp"
+#include "TaskTrace.hpp"
+
+// Delivered to the continuation when a task was still queued at its deadline
+class DeadlineExceeded : public std::runtime_error
+{
+    public:
+        DeadlineExceeded() : std::runtime_error("deadline exceeded") {}
+};
+
+// Resumes an awaiting coroutine whose operation was cancelled
+class OperationCancelled : public std::runtime_error
+{
+    public:
+        OperationCancelled() : std::runtime_error("operation cancelled") {}
+};
+
+// Outcome of a task run by a worker: either a value or the exception the
+// task threw. A continuation that takes a TaskResult<T> sees failures;
+// get() returns the value or rethrows.
+template<typename T>
+class TaskResult
+{
+    public:
+        bool hasError() const { return error_ != nullptr; }
+        std::exception_ptr error() const { return error_; }
+
+        T get()
+        {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+            return std::move(*value_);
+        }
+
+        template<typename... Args>
+            void setValue(Args&&... args)
+            {
+                value_.emplace(std::forward<Args>(args)...);
+            }
+
+        void setError(std::exception_ptr e) { error_ = std::move(e); }
+
+    private:
+        std::optional<T> value_;
+        std::exception_ptr error_;
+};
+
+template<>
+class TaskResult<void>
+{
+    public:
+        bool hasError() const { return error_ != nullptr; }
+        std::exception_ptr error() const { return error_; }
+
+        void get()
+        {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+        }
+
+        void setValue() {}
+        void setError(std::exception_ptr e) { error_ = std::move(e); }
+
+    private:
+        std::exception_ptr error_;
+};
+
+// One submitted task: execute() runs on a worker, complete() runs on the
+// reactor thread afterwards. The reactor owns the object and deletes it
+// once complete() returns. Once the token is cancelled the reactor skips
+// complete() and only deletes it.
+class Completion
+{
+    public:
+        explicit Completion(CancellationToken token)
+            : token_(std::move(token)) {}
+        virtual ~Completion() = default;
+        virtual void execute() = 0;
+        virtual void complete() = 0;
+        // Called instead of execute() when the task will not run
+        virtual void fail(std::exception_ptr e) = 0;
+        bool isCancelled() const { return token_.isCancelled(); }
+
+        // TaskOptions::name, for traces and stall reports
+        const char* name = "task";
+        // Set for the tasks TaskTracer samples, null otherwise
+        std::unique_ptr<TaskTrace> trace;
+        // steady_clock ns at submit, only while task__complete is probed
+        uint64_t submittedNs = 0;
+        // Ties the task's TraceRecorder flow events together, while
+        // tracing; unlike the address, never reused within a reactor
+        uint64_t flowId = 0;
+
+    protected:
+        CancellationToken token_;
+};
+
+// Holds the task, its continuation and the result slot in a single
+// allocation. Nothing is copied: callables are forwarded in and the
+// result is moved into the continuation, so move-only results work.
+// Long tasks can take a const CancellationToken& to stop early.
+template<typename TaskFn, typename Continuation>
+class TypedCompletion : public Completion
+{
+        static constexpr bool takesToken =
+            std::is_invocable_v<TaskFn&, const CancellationToken&>;
+
+    public:
+        using Result = std::remove_cvref_t<typename std::conditional_t<takesToken,
+              std::invoke_result<TaskFn&, const CancellationToken&>,
+              std::invoke_result<TaskFn&>>::type>;
+
+        template<typename F, typename C>
+            TypedCompletion(CancellationToken token, F&& taskFn, C&& continuation)
+            : Completion(std::move(token)),
+              taskFn_(std::forward<F>(taskFn)),
+              continuation_(std::forward<C>(continuation)) {}
+
+        void execute() override
+        {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    run();
+                    result_.setValue();
+                } else {
+                    result_.setValue(run());
+                }
+            } catch (...) {
+                result_.setError(std::current_exception());
+            }
+        }
+
+        void fail(std::exception_ptr e) override
+        {
+            result_.setError(std::move(e));
+        }
+
+        void complete() override
+        {
+            if constexpr (std::is_invocable_v<Continuation&, TaskResult<Result>&&>) {
+                continuation_(std::move(result_));
+            } else if (result_.hasError()) {
+                // Continuation only takes values: nobody can observe the failure
+                try {
+                    std::rethrow_exception(result_.error());
+                } catch (const DeadlineExceeded&) {
+                    // Expected under overload, not worth a log line each
+                } catch (const std::exception& e) {
+                    std::cerr << "[Reactor] Task failed: " << e.what() << std::endl;
+                } catch (...) {
+                    std::cerr << "[Reactor] Task failed" << std::endl;
+                }
+            } else if constexpr (std::is_void_v<Result>) {
+                continuation_();
+            } else {
+                continuation_(result_.get());
+            }
+        }
+
+    private:
+        decltype(auto) run()
+        {
+            if constexpr (takesToken) {
+                return taskFn_(std::as_const(token_));
+            } else {
+                return taskFn_();
+            }
+        }
+
+        TaskFn taskFn_;
+        Continuation continuation_;
+        TaskResult<Result> result_;
+};
+
+#endif
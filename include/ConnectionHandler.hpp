@@ -1,25 +1,74 @@
 #ifndef CONNECTION_HANDLER_H
 #define CONNECTION_HANDLER_H
 
+#include "CancellationToken.hpp"
 #include "EventHandler.hpp"
 #include "Reactor.hpp"
+#include <chrono>
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <string>
 
+// Line echo: every line comes back prefixed with "Async ". Reading stops
+// while maxOutput_ bytes of replies wait for the socket and resumes as
+// handleWrite drains them; a line longer than maxLine_ is answered with an
+// error and dropped instead of buffered.
 class ConnectionHandler : public EventHandler,
                           public std::enable_shared_from_this<ConnectionHandler> {
     public:
         ConnectionHandler(int fd, Reactor* reactor)
-            : fd_(fd), reactor_(reactor) {}
+            : fd_(fd), reactor_(reactor), stats_(reactor->connectionStats().open(fd))
+        {
+            reactor_->metrics().connectionsOpened.add();
+        }
 
         int getHandle() const override { return fd_; }
 
         void handleRead() override;
+        // Flushes output the socket did not take at once; needs EPOLLOUT
+        void handleWrite() override;
+        void handleClose() override;
 
     private:
+        // Clients stop waiting for a reply after this long
+        static constexpr std::chrono::milliseconds replyDeadline_{5000};
+        // Reading pauses while this much output waits for a slow client
+        static constexpr size_t maxOutput_ = 1 << 20;
+        static constexpr size_t maxLine_ = 64 * 1024;
+
+        struct Reply
+        {
+            std::string text;
+            uint64_t taskNs;
+        };
+
         int fd_;
-        int totalBytesRead_ = 0;
         Reactor* reactor_;
+        ConnectionStatsTable::Slot stats_;
+        std::string inputBuffer_;
+        // Dropping input up to the end of a line over maxLine_
+        bool discarding_ = false;
+        // Replies the socket buffer had no room for; bytes before
+        // outputSent_ are already sent
+        std::string outputBuffer_;
+        size_t outputSent_ = 0;
+        // Cancelled on close so queued work for this connection is dropped
+        CancellationSource cancel_;
+
+        // Responses may complete out of order when several workers run
+        // tasks of the same connection. Each request gets a sequence number
+        // at submission; replies wait in reorderBuffer_ until every earlier
+        // one has been sent.
+        uint64_t nextSeq_ = 0;
+        uint64_t nextToSend_ = 0;
+        std::map<uint64_t, std::string> reorderBuffer_;
+
         void scheduleTask(std::string message);
+        void deliver(uint64_t seq, std::string response);
+        void send(const std::string& data);
+        void flush();
+        ConnectionStats& stats() { return reactor_->connectionStats()[stats_]; }
 };
 
 #endif
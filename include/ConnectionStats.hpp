@@ -0,0 +1,62 @@
+#ifndef CONNECTION_STATS_H
+#define CONNECTION_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Traffic of one connection, one cache line per row
+struct alignas(64) ConnectionStats
+{
+    int32_t fd = -1;
+    uint16_t peerPort = 0;
+    // IPv4 peer in network byte order, 0 if unknown
+    uint32_t peerAddr = 0;
+    uint32_t tasksInFlight = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t messagesIn = 0;
+    uint64_t messagesOut = 0;
+    // Time spent running this connection's tasks, worker or inline
+    uint64_t taskNs = 0;
+    // Bytes waiting for the socket to drain
+    uint64_t outputQueued = 0;
+};
+
+static_assert(sizeof(ConnectionStats) == 64, "ConnectionStats must fit one cache line");
+
+// What topN() ranks by
+enum class ConnectionStat { BytesIn, BytesOut, Messages, TasksInFlight, TaskTime, OutputQueued };
+constexpr size_t connectionStatCount = 6;
+const char* connectionStatName(ConnectionStat stat);
+
+// Per-connection counters in one contiguous array, so updates touch a
+// single line and a top-N scan walks memory in order. Rows are reused
+// through a free list; a connection keeps its slot from open() to
+// close(). Reactor thread only.
+class ConnectionStatsTable
+{
+    public:
+        using Slot = uint32_t;
+
+        // Claims a row for fd and records its peer address
+        Slot open(int fd);
+        void close(Slot slot);
+
+        // Valid until the next open()
+        ConnectionStats& operator[](Slot slot) { return rows_[slot]; }
+
+        size_t openCount() const { return rows_.size() - free_.size(); }
+
+        // Copies of the n open connections with the largest stat
+        std::vector<ConnectionStats> topN(ConnectionStat stat, size_t n) const;
+        // Plain-text report with the top n per dimension
+        std::string dump(size_t n) const;
+
+    private:
+        std::vector<ConnectionStats> rows_;
+        std::vector<Slot> free_;
+};
+
+#endif
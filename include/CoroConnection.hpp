@@ -0,0 +1,58 @@
+#ifndef CORO_CONNECTION_H
+#define CORO_CONNECTION_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include "AsyncGenerator.hpp"
+#include "CoroTask.hpp"
+#include "Reactor.hpp"
+
+// A non-blocking socket driven by coroutines instead of EventHandler
+// callbacks. Owns the fd: it is unwatched and closed on destruction.
+// All members must be used from the reactor thread.
+class CoroConnection
+{
+    public:
+        CoroConnection(int fd, Reactor* reactor);
+        ~CoroConnection();
+        CoroConnection(const CoroConnection&) = delete;
+        CoroConnection& operator=(const CoroConnection&) = delete;
+
+        int getHandle() const { return fd_; }
+
+        // Next line without its '\n', or nullopt once the peer has closed
+        CoroTask<std::optional<std::string>> readLine();
+        // Every line without its '\n', as a view into the input buffer that
+        // stays valid until the next next(). Nothing is copied, and the
+        // socket is only read while the consumer asks for more.
+        AsyncGenerator<std::string_view> lines();
+        // The next n bytes, for framing that is not line based, as a view
+        // valid until the next read or line; nullopt if the peer closed
+        // first. May be interleaved with a lines() generator.
+        CoroTask<std::optional<std::string_view>> read(size_t n);
+        // Sends all of data, suspending while the socket buffer is full.
+        // data must stay valid until the returned task completes.
+        // Returns false if the peer went away.
+        CoroTask<bool> write(std::string_view data);
+
+    private:
+        enum class Fill { Data, WouldBlock, Closed };
+
+        int fd_;
+        Reactor* reactor_;
+        ConnectionStatsTable::Slot stats_;
+        // Bytes before start_ are already consumed; scanned_ is where the
+        // search for the next '\n' resumes
+        std::string inputBuffer_;
+        size_t start_ = 0;
+        size_t scanned_ = 0;
+
+        Fill fill();
+        ConnectionStats& stats() { return reactor_->connectionStats()[stats_]; }
+};
+
+// Echo session equivalent to ConnectionHandler, written as one coroutine
+CoroTask<void> coroEchoSession(Reactor* reactor, int fd);
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef CORO_TASK_H
+#define CORO_TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <utility>
+#include "CancelScope.hpp"
+#include "FramePool.hpp"
+
+// Lazily started coroutine returning T. Awaiting a CoroTask starts it and
+// resumes the awaiter when it finishes, by symmetric transfer, so chains
+// of co_await never grow the stack and never go through std::function.
+// Named CoroTask because Task is the worker pool's unit of work.
+template<typename T = void>
+class CoroTask;
+
+namespace coro_detail {
+
+struct FinalAwaiter
+{
+    bool await_ready() noexcept { return false; }
+
+    template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            auto& p = h.promise();
+            if (p.continuation) {
+                return p.continuation;
+            }
+            if (p.detached) {
+                // Nobody will read the result of a spawned coroutine
+                if (p.exception) {
+                    try {
+                        std::rethrow_exception(p.exception);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Coro] Unhandled exception: " << e.what() << std::endl;
+                    } catch (...) {
+                        std::cerr << "[Coro] Unhandled exception" << std::endl;
+                    }
+                }
+                h.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+    void await_resume() noexcept {}
+};
+
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+    bool detached = false;
+    // Inherited from the awaiting coroutine unless set explicitly
+    CancelScope* cancelScope = nullptr;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    // Frames come from the reactor's FramePool, not the global heap
+    static void* operator new(std::size_t size) { return FramePool::allocateFrame(size); }
+    static void operator delete(void* frame, std::size_t size) { FramePool::freeFrame(frame, size); }
+};
+
+template<typename T>
+struct Promise : PromiseBase
+{
+    std::optional<T> value;
+
+    CoroTask<T> get_return_object();
+
+    template<typename U>
+        void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+    T take()
+    {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template<>
+struct Promise<void> : PromiseBase
+{
+    CoroTask<void> get_return_object();
+
+    void return_void() {}
+
+    void take()
+    {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+// Scope of the coroutine behind h, for awaiters that can be cancelled
+template<typename Promise>
+CancelScope* cancelScopeOf(std::coroutine_handle<Promise> h)
+{
+    if constexpr (requires { h.promise().cancelScope; }) {
+        return h.promise().cancelScope;
+    } else {
+        return nullptr;
+    }
+}
+
+}
+
+// co_await currentCancelScope() yields the awaiting coroutine's scope
+struct currentCancelScope
+{
+    CancelScope* scope = nullptr;
+
+    bool await_ready() const noexcept { return false; }
+
+    template<typename Promise>
+        bool await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            scope = coro_detail::cancelScopeOf(h);
+            return false;
+        }
+
+    CancelScope* await_resume() const noexcept { return scope; }
+};
+
+template<typename T>
+class CoroTask
+{
+    public:
+        using promise_type = coro_detail::Promise<T>;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        explicit CoroTask(Handle h) : coro_(h) {}
+        CoroTask(CoroTask&& other) noexcept : coro_(std::exchange(other.coro_, {})) {}
+        CoroTask& operator=(CoroTask&& other) noexcept
+        {
+            if (this != &other) {
+                if (coro_) {
+                    coro_.destroy();
+                }
+                coro_ = std::exchange(other.coro_, {});
+            }
+            return *this;
+        }
+        CoroTask(const CoroTask&) = delete;
+        CoroTask& operator=(const CoroTask&) = delete;
+
+        ~CoroTask()
+        {
+            if (coro_) {
+                coro_.destroy();
+            }
+        }
+
+        struct Awaiter
+        {
+            Handle coro;
+
+            bool await_ready() const noexcept { return !coro || coro.done(); }
+
+            template<typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> awaiting) noexcept
+                {
+                    auto& p = coro.promise();
+                    p.continuation = awaiting;
+                    if (!p.cancelScope) {
+                        p.cancelScope = coro_detail::cancelScopeOf(awaiting);
+                    }
+                    return coro;
+                }
+
+            T await_resume() { return coro.promise().take(); }
+        };
+
+        Awaiter operator co_await() const noexcept { return Awaiter{coro_}; }
+
+        bool done() const { return !coro_ || coro_.done(); }
+
+        // Must be called before the task is started
+        void setCancelScope(CancelScope* scope) { coro_.promise().cancelScope = scope; }
+
+        // Starts the coroutine and gives up ownership: the frame destroys
+        // itself when it finishes. Used by Reactor::spawn.
+        void startDetached()
+        {
+            Handle h = std::exchange(coro_, {});
+            h.promise().detached = true;
+            h.resume();
+        }
+
+    private:
+        Handle coro_;
+};
+
+namespace coro_detail {
+
+template<typename T>
+inline CoroTask<T> Promise<T>::get_return_object()
+{
+    return CoroTask<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline CoroTask<void> Promise<void>::get_return_object()
+{
+    return CoroTask<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef CORO_TIMEOUT_H
+#define CORO_TIMEOUT_H
+
+#include <optional>
+#include <type_traits>
+#include "CancelScope.hpp"
+#include "Completion.hpp"
+#include "CoroTask.hpp"
+#include "Reactor.hpp"
+
+// What withTimeout yields: the value, or nothing if time ran out. For
+// CoroTask<void> it is true when the operation finished in time.
+template<typename T>
+using TimeoutResult = std::conditional_t<std::is_void_v<T>, bool, std::optional<T>>;
+
+// Runs op but gives up after ms. On expiry op is cancelled through its
+// CancelScope: whatever it is suspended in (readable/writable/sleep, or
+// a nested withTimeout) resumes with OperationCancelled, op unwinds, and
+// only then does withTimeout return. Work already running on a worker is
+// not interrupted; its result is discarded.
+//
+//     auto line = co_await withTimeout(reactor, conn.readLine(), 5000);
+template<typename T>
+CoroTask<TimeoutResult<T>> withTimeout(Reactor& reactor, CoroTask<T> op, uint64_t ms)
+{
+    CancelScope scope;
+    op.setCancelScope(&scope);
+
+    // Cancellation of the caller reaches op through our scope
+    CancelScope* outer = co_await currentCancelScope();
+    if (outer && outer->requested()) {
+        throw OperationCancelled();
+    }
+
+    bool timedOut = false;
+    int timerId = reactor.addTimer(ms, false, [&scope, &timedOut]() {
+            timedOut = true;
+            scope.request();
+            });
+
+    if (outer) {
+        outer->arm([](void* inner) { static_cast<CancelScope*>(inner)->request(); }, &scope);
+    }
+
+    // The timer and the outer scope point into this frame. However op
+    // ends (a value, any exception, or this frame destroyed while
+    // suspended), both are let go before the frame is.
+    struct Release
+    {
+        Reactor& reactor;
+        int timerId;
+        CancelScope* outer;
+        ~Release()
+        {
+            reactor.cancelTimer(timerId);
+            if (outer) {
+                outer->disarm();
+            }
+        }
+    } release{reactor, timerId, outer};
+
+    bool cancelled = false;
+    std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> value;
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await op;
+            value = true;
+        } else {
+            value.emplace(co_await op);
+        }
+    } catch (const OperationCancelled&) {
+        cancelled = true;
+    }
+
+    if (cancelled && !timedOut) {
+        // Not ours: the caller was cancelled
+        throw OperationCancelled();
+    }
+
+    if constexpr (std::is_void_v<T>) {
+        co_return !timedOut;
+    } else {
+        if (timedOut) {
+            co_return std::nullopt;
+        }
+        co_return std::move(value);
+    }
+}
+
+#endif
@@ -7,6 +7,8 @@ class EventHandler {
     public:
         virtual void handleRead() {}
         virtual void handleWrite() {}
+        // Called by the reactor when the handler is removed, before the fd is closed
+        virtual void handleClose() {}
         virtual int getHandle() const = 0;
         virtual ~EventHandler() = default;
 };
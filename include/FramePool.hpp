@@ -0,0 +1,58 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Size-classed free lists for coroutine frames. Each Reactor owns one and
+// makes it the current pool of its thread while its eventLoop runs;
+// CoroTask promises allocate from the current pool. Frames are created and destroyed on the reactor
+// thread, so the lists take no locks.
+//
+// Every block starts with a small header naming the pool it came from,
+// so a frame always goes back to its own pool and frames allocated with
+// no current pool (on a worker, or spawned before the loop starts) fall
+// back to the global heap.
+class FramePool
+{
+    public:
+        static constexpr size_t classCount = 6;
+        static constexpr size_t smallestClass = 64;
+        static constexpr size_t largestClass = smallestClass << (classCount - 1);
+        // Free blocks kept per class; beyond that they go back to the heap
+        static constexpr size_t maxCachedPerClass = 4096;
+
+        struct Stats
+        {
+            uint64_t allocations;
+            uint64_t reused;
+        };
+
+        FramePool() = default;
+        ~FramePool();
+        FramePool(const FramePool&) = delete;
+        FramePool& operator=(const FramePool&) = delete;
+
+        Stats stats() const { return stats_; }
+
+        static FramePool* current();
+        static void setCurrent(FramePool* pool);
+
+        // Entry points for promise_type::operator new/delete
+        static void* allocateFrame(size_t size);
+        static void freeFrame(void* frame, size_t size);
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock* next;
+        };
+
+        FreeBlock* freeLists_[classCount] = {};
+        size_t cached_[classCount] = {};
+        Stats stats_{0, 0};
+
+        static int sizeClass(size_t size);
+};
+
+#endif
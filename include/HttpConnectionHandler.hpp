@@ -0,0 +1,144 @@
+#ifndef HTTP_CONNECTION_HANDLER_H
+#define HTTP_CONNECTION_HANDLER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CancellationToken.hpp"
+#include "EventHandler.hpp"
+#include "HttpParser.hpp"
+#include "Reactor.hpp"
+
+struct HttpResponse
+{
+    int status = 200;
+    std::string contentType = "text/plain";
+    std::string body;
+    // When not empty the response is sent with Transfer-Encoding: chunked,
+    // one chunk per element, and body is ignored. HTTP/1.0 clients get
+    // the chunks joined with a Content-Length instead.
+    std::vector<std::string> chunks;
+};
+
+using HttpHandler = std::function<HttpResponse(const HttpRequest&)>;
+
+// Routes requests by exact path to handlers. One service is shared by
+// every connection of a listener; set up the routes before serving.
+class HttpService
+{
+    public:
+        struct Route
+        {
+            HttpHandler handler;
+            // Run through Reactor::submitTask instead of inline
+            bool worker;
+            // TaskOptions::name of worker routes
+            const char* name;
+        };
+
+        // handler runs on the reactor thread as soon as the request is
+        // parsed; keep it short
+        void route(std::string path, HttpHandler handler);
+        // handler runs on a worker with its own copy of the request;
+        // responses still go out in request order
+        void routeToWorker(std::string path, HttpHandler handler, const char* name = "http");
+
+        // Null if nothing serves path
+        const Route* find(std::string_view path) const;
+
+    private:
+        // std::less<> finds by string_view without building a string
+        std::map<std::string, Route, std::less<>> routes_;
+};
+
+// HTTP/1.1 server side of one connection: keep-alive, pipelining and
+// chunked responses. Requests are parsed in place from the input buffer
+// by HttpParser; every complete request in a read is dispatched before
+// the next recv, and responses are queued in request order and written
+// with one send per batch. Register it with EPOLLOUT: output the socket
+// did not take is sent from handleWrite.
+//
+// At most maxPipeline_ requests wait for their response, and at most
+// maxOutput_ bytes of responses wait for the socket; beyond either the
+// handler stops reading until responses catch up. After a response with
+// "Connection: close" (the client asked for it, or the request was bad)
+// the write side is shut down and input is discarded until the client
+// closes, so the response is not lost to a reset.
+class HttpConnectionHandler : public EventHandler,
+                              public std::enable_shared_from_this<HttpConnectionHandler> {
+    public:
+        HttpConnectionHandler(int fd, Reactor* reactor, std::shared_ptr<const HttpService> service)
+            : fd_(fd), reactor_(reactor), service_(std::move(service)),
+              stats_(reactor->connectionStats().open(fd))
+        {
+            reactor_->metrics().connectionsOpened.add();
+        }
+
+        int getHandle() const override { return fd_; }
+
+        void handleRead() override;
+        void handleWrite() override;
+        void handleClose() override;
+
+    private:
+        static constexpr size_t maxPipeline_ = 64;
+        static constexpr size_t readSize_ = 4096;
+        // Reading pauses while this much output waits for a slow client
+        static constexpr size_t maxOutput_ = 1 << 20;
+        // How long a closing connection waits for the client to hang up
+        static constexpr uint64_t lingerMs_ = 2000;
+
+        // A response serialised on a worker
+        struct Reply
+        {
+            std::string bytes;
+            uint64_t taskNs;
+        };
+
+        int fd_;
+        Reactor* reactor_;
+        std::shared_ptr<const HttpService> service_;
+        ConnectionStatsTable::Slot stats_;
+        std::string inputBuffer_;
+        HttpParser parser_;
+        // Reused for every request; views into inputBuffer_
+        HttpRequest request_;
+        // Bytes before outputSent_ are already sent
+        std::string outputBuffer_;
+        size_t outputSent_ = 0;
+        // Cancelled on close so queued work for this connection is dropped
+        CancellationSource cancel_;
+
+        // Responses are numbered in request order and wait in
+        // reorderBuffer_ until every earlier one is queued, as in
+        // ConnectionHandler
+        uint64_t nextSeq_ = 0;
+        uint64_t nextToSend_ = 0;
+        std::map<uint64_t, std::string> reorderBuffer_;
+
+        // No request is parsed after one that closes the connection
+        bool closing_ = false;
+        bool lingering_ = false;
+        int lingerTimer_ = -1;
+
+        void parseRequests();
+        void dispatch(const char* raw, size_t length);
+        void deliver(uint64_t seq, std::string bytes);
+        void flush();
+        void linger();
+        // Reads until EAGAIN; false once the handler was removed
+        bool readInput();
+        bool outputFull() const { return outputBuffer_.size() - outputSent_ >= maxOutput_; }
+        ConnectionStats& stats() { return reactor_->connectionStats()[stats_]; }
+};
+
+// Status line, headers and body of response, appended to out
+void serializeHttpResponse(std::string& out, const HttpResponse& response,
+                           const HttpRequest& request);
+
+#endif
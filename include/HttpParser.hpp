@@ -0,0 +1,85 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <cstddef>
+#include <string_view>
+
+struct HttpHeader
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+// One parsed HTTP/1.x request. Every view points into the buffer given to
+// HttpParser::parse and is only valid while that buffer is unchanged.
+struct HttpRequest
+{
+    static constexpr size_t maxHeaders = 32;
+
+    std::string_view method;
+    // Request target as sent, query string included
+    std::string_view target;
+    // The x of HTTP/1.x
+    int minorVersion = 1;
+    HttpHeader headers[maxHeaders];
+    size_t headerCount = 0;
+    std::string_view body;
+    // HTTP/1.1 unless "Connection: close", HTTP/1.0 only with
+    // "Connection: keep-alive"
+    bool keepAlive = true;
+
+    // target up to the '?'
+    std::string_view path() const;
+    // Value of the first header called name (case-insensitive), empty if absent
+    std::string_view header(std::string_view name) const;
+    // Moves every view from one copy of the request bytes to another
+    void rebase(const char* from, const char* to);
+};
+
+// Whether a comma-separated header value such as Connection lists token,
+// ignoring case
+bool httpHeaderHasToken(std::string_view value, std::string_view token);
+
+// Incremental HTTP/1.x request parser that never allocates. Feed it the
+// same growing buffer until it returns Complete, then drop consumed()
+// bytes from the front and call reset() before the next request.
+//
+// The end of the head is searched only in bytes not seen before, so a
+// request arriving in many small reads costs one scan overall. Header
+// lines are scanned 16 bytes at a time with SSE2 for the next CR, LF or
+// other control byte, which also rejects invalid bytes on the way.
+//
+// Request bodies need Content-Length; chunked request bodies are refused
+// with 501 since nothing here consumes them.
+class HttpParser
+{
+    public:
+        enum class Status { Complete, Incomplete, Error };
+
+        // Largest request head accepted, answered with 431 beyond that
+        static constexpr size_t maxHead = 8192;
+        static constexpr size_t maxBody = 1 << 20;
+
+        Status parse(const char* data, size_t len, HttpRequest& req);
+
+        // Bytes of the Complete request, head and body
+        size_t consumed() const { return consumed_; }
+        // HTTP status to answer an Error with
+        int errorStatus() const { return errorStatus_; }
+        void reset();
+
+    private:
+        // Bytes already known not to end the head, and the head's length
+        // once found
+        size_t scanned_ = 0;
+        size_t headLength_ = 0;
+        size_t bodyLength_ = 0;
+        size_t consumed_ = 0;
+        int errorStatus_ = 0;
+
+        size_t findHeadEnd(const char* data, size_t len);
+        Status parseHead(const char* data, HttpRequest& req);
+        Status fail(int status);
+};
+
+#endif
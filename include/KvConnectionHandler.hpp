@@ -0,0 +1,75 @@
+#ifndef KV_CONNECTION_HANDLER_H
+#define KV_CONNECTION_HANDLER_H
+
+#include <memory>
+#include <string>
+#include "EventHandler.hpp"
+#include "KvStore.hpp"
+#include "Reactor.hpp"
+#include "RespParser.hpp"
+
+// Redis protocol (RESP2) front end of a KvStore: GET, SET [EX s|PX ms],
+// DEL, INCR, EXPIRE, MGET and PING, so redis-cli and redis-benchmark can
+// talk to it. Every command of a read is parsed and executed in one pass
+// and the replies go out with one send. Commands run inline on the
+// reactor thread; the store is never touched from a worker.
+//
+// Register it with EPOLLOUT. Reading stops while more than maxOutput_
+// bytes of replies are queued and resumes as handleWrite drains them, so
+// a client that pipelines without reading cannot grow the buffer without
+// bound.
+//
+// After QUIT or a protocol error it sends what is queued, shuts down its
+// side and waits up to lingerMs_ for the client to hang up, so the last
+// reply is not lost to a reset.
+class KvConnectionHandler : public EventHandler,
+                            public std::enable_shared_from_this<KvConnectionHandler> {
+    public:
+        // store must outlive the reactor's event loop
+        KvConnectionHandler(int fd, Reactor* reactor, KvStore* store)
+            : fd_(fd), reactor_(reactor), store_(store),
+              stats_(reactor->connectionStats().open(fd))
+        {
+            reactor_->metrics().connectionsOpened.add();
+        }
+
+        int getHandle() const override { return fd_; }
+
+        void handleRead() override;
+        void handleWrite() override;
+        void handleClose() override;
+
+    private:
+        static constexpr size_t readSize_ = 4096;
+        static constexpr size_t maxOutput_ = 1 << 20;
+        // Longest TTL SET EX/PX and EXPIRE accept: one year
+        static constexpr int64_t maxTtlMs_ = int64_t(365) * 24 * 3600 * 1000;
+        // How long a closing connection waits for the client to hang up
+        static constexpr uint64_t lingerMs_ = 2000;
+
+        int fd_;
+        Reactor* reactor_;
+        KvStore* store_;
+        ConnectionStatsTable::Slot stats_;
+        std::string inputBuffer_;
+        RespParser parser_;
+        // Reused for every command; views into inputBuffer_
+        RespCommand command_;
+        // Bytes before outputSent_ are already sent
+        std::string outputBuffer_;
+        size_t outputSent_ = 0;
+        // Set by QUIT and protocol errors: close once replies are sent
+        bool closing_ = false;
+        bool lingering_ = false;
+        bool removed_ = false;
+        int lingerTimer_ = -1;
+
+        void parseCommands();
+        void execute(const RespCommand& cmd);
+        // False once the handler was removed
+        bool flush();
+        void linger();
+        ConnectionStats& stats() { return reactor_->connectionStats()[stats_]; }
+};
+
+#endif
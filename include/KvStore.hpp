@@ -0,0 +1,130 @@
+#ifndef KV_STORE_H
+#define KV_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+class Reactor;
+
+// String that keeps up to inlineCapacity bytes in the object itself and
+// only allocates for longer ones. 24 bytes either way.
+class SmallString
+{
+    public:
+        static constexpr size_t inlineCapacity = 22;
+
+        SmallString() { buf_[0] = '\0'; }
+        SmallString(const SmallString&) = delete;
+        SmallString& operator=(const SmallString&) = delete;
+        SmallString(SmallString&& other) noexcept
+        {
+            std::memcpy(buf_, other.buf_, sizeof(buf_));
+            tag_ = other.tag_;
+            other.tag_ = 0;
+        }
+        SmallString& operator=(SmallString&& other) noexcept
+        {
+            if (this != &other) {
+                release();
+                std::memcpy(buf_, other.buf_, sizeof(buf_));
+                tag_ = other.tag_;
+                other.tag_ = 0;
+            }
+            return *this;
+        }
+        ~SmallString() { release(); }
+
+        void assign(std::string_view s);
+        std::string_view view() const
+        {
+            if (tag_ != onHeap) {
+                return std::string_view(buf_, tag_);
+            }
+            Heap h;
+            std::memcpy(&h, buf_, sizeof(h));
+            return std::string_view(h.data, h.size);
+        }
+        bool isInline() const { return tag_ != onHeap; }
+
+    private:
+        static constexpr uint8_t onHeap = 0xff;
+
+        struct Heap
+        {
+            char* data;
+            size_t size;
+        };
+
+        // Inline bytes, or a Heap when tag_ is onHeap
+        char buf_[inlineCapacity + 1];
+        // Inline length, or onHeap
+        uint8_t tag_ = 0;
+
+        void release();
+};
+
+static_assert(sizeof(SmallString) == 24, "SmallString must stay 24 bytes");
+
+// In-memory string store behind KvConnectionHandler. Open addressing with
+// linear probing over one array of cache-line entries, each holding the
+// hash, the key and the value inline when they are short, so a lookup of
+// a small key is usually one cache miss. Deletion shifts the following
+// entries back instead of leaving tombstones, so probe chains stay short
+// under churn. The table doubles at 3/4 load.
+//
+// Expiries are one-shot reactor timers; an entry remembers its timer so
+// SET, DEL and a new EXPIRE cancel it. Reactor thread only.
+class KvStore
+{
+    public:
+        explicit KvStore(Reactor* reactor);
+        ~KvStore();
+        KvStore(const KvStore&) = delete;
+        KvStore& operator=(const KvStore&) = delete;
+
+        // False if key is absent; value is valid until the next change
+        bool get(std::string_view key, std::string_view& value) const;
+        // Stores value and drops any expiry, as Redis SET does
+        void set(std::string_view key, std::string_view value);
+        bool erase(std::string_view key);
+        // Adds delta to an integer value, creating it at 0. False if the
+        // value is not an integer or the result would overflow. Keeps the
+        // expiry.
+        bool incr(std::string_view key, int64_t delta, int64_t& result);
+        // Deletes key after ms (at once for 0). False if key is absent.
+        bool expire(std::string_view key, uint64_t ms);
+
+        size_t size() const { return size_; }
+        size_t capacity() const { return entries_.size(); }
+
+    private:
+        struct alignas(64) Entry
+        {
+            // 0 marks an empty slot
+            uint64_t hash = 0;
+            SmallString key;
+            SmallString value;
+            int timer = -1;
+        };
+
+        static_assert(sizeof(Entry) == 64, "KvStore entries must fit one cache line");
+
+        Reactor* reactor_;
+        std::vector<Entry> entries_;
+        size_t size_ = 0;
+
+        static uint64_t hashOf(std::string_view key);
+        size_t mask() const { return entries_.size() - 1; }
+        Entry* find(std::string_view key, uint64_t hash);
+        const Entry* find(std::string_view key, uint64_t hash) const;
+        // Existing entry for key, or a new one with an empty value
+        Entry& insert(std::string_view key);
+        void eraseAt(size_t slot);
+        void cancelExpiry(Entry& e);
+        void grow();
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// HDR-style log-linear histogram of nanosecond values: exact below 256,
+// then 128 buckets per power of two (under 0.8% relative error) up to
+// 2^44 ns (about 4.9 hours); larger values land in the last bucket.
+// About 38 KiB of counters.
+//
+// One thread records, any thread may read at the same time. Counters are
+// atomics updated with relaxed load+store rather than read-modify-write,
+// so record() costs a bucket computation and two plain moves on x86.
+// Readers see a slightly stale but never torn view.
+class LatencyHistogram
+{
+    public:
+        static constexpr int subBucketBits = 8;
+        static constexpr int maxExponent = 44;
+        static constexpr size_t bucketCount =
+            (size_t(1) << subBucketBits) + (maxExponent - subBucketBits) * (size_t(1) << (subBucketBits - 1));
+
+        LatencyHistogram() = default;
+        LatencyHistogram(const LatencyHistogram&) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+        void record(uint64_t value)
+        {
+            bump(counts_[bucketOf(value)], 1);
+            bump(total_, 1);
+            bump(sum_, value);
+            if (value > max_.load(std::memory_order_relaxed)) {
+                max_.store(value, std::memory_order_relaxed);
+            }
+        }
+
+        // Adds other's counts; other may still be recording
+        void merge(const LatencyHistogram& other);
+        void reset();
+
+        uint64_t count() const { return total_.load(std::memory_order_relaxed); }
+        uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+        uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+        double mean() const;
+        // Upper bound of the bucket holding the q-th quantile (0..1)
+        uint64_t percentile(double q) const;
+
+        uint64_t bucketCountAt(size_t i) const { return counts_[i].load(std::memory_order_relaxed); }
+        static uint64_t bucketUpperBound(size_t i);
+
+        static size_t bucketOf(uint64_t value)
+        {
+            const uint64_t linear = uint64_t(1) << subBucketBits;
+            if (value < linear) {
+                return size_t(value);
+            }
+            int msb = 63 - __builtin_clzll(value);
+            if (msb >= maxExponent) {
+                return bucketCount - 1;
+            }
+            int shift = msb - (subBucketBits - 1);
+            uint64_t top = value >> shift;
+            return linear + size_t(msb - subBucketBits) * (linear / 2) + size_t(top - linear / 2);
+        }
+
+    private:
+        static void bump(std::atomic<uint64_t>& c, uint64_t by)
+        {
+            c.store(c.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+        }
+
+        std::atomic<uint64_t> counts_[bucketCount] = {};
+        std::atomic<uint64_t> total_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> max_{0};
+};
+
+#endif
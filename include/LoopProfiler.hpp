@@ -0,0 +1,94 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "LatencyHistogram.hpp"
+
+// Where Reactor::eventLoop spends its time
+enum class LoopPhase { Wait, Dispatch, Completions, Timers };
+constexpr size_t loopPhaseCount = 4;
+const char* loopPhaseName(LoopPhase phase);
+
+// Tick source for the profiler: the TSC when the CPU says it is invariant,
+// CLOCK_MONOTONIC_RAW otherwise. calibrate() must run before now().
+class PhaseClock
+{
+    public:
+        static void calibrate();
+        static bool usesTsc() { return useTsc_; }
+
+        static uint64_t now()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            if (useTsc_) {
+                return __rdtsc();
+            }
+#endif
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+            return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+        }
+
+        static uint64_t toNs(uint64_t ticks)
+        {
+            return uint64_t((unsigned __int128)ticks * nsPerTickQ32_ >> 32);
+        }
+
+    private:
+        static inline bool useTsc_ = false;
+        // Nanoseconds per tick in 32.32 fixed point
+        static inline uint64_t nsPerTickQ32_ = uint64_t(1) << 32;
+};
+
+// Per-phase histograms of eventLoop iterations. Off by default; enable()
+// may be called from any thread and the histograms may be read while the
+// loop runs.
+//
+// A sample is one clock read plus LatencyHistogram::record (about 5 ns).
+// rdtsc costs about 7 ns on bare metal; on the VM used for
+// loop_profiler_lap in reactor_microbench it measured 17 ns, for 22 ns per
+// sample. The CLOCK_MONOTONIC_RAW fallback (vDSO) costs about 30 ns. An
+// iteration takes four samples, or three without completions. Disabled,
+// each lap is one load of a flag.
+class LoopProfiler
+{
+    public:
+        void enable(bool on);
+        // Acquire pairs with enable() so the clock calibration is visible
+        bool enabled() const { return enabled_.load(std::memory_order_acquire); }
+
+        // Start of a phase, 0 while disabled
+        uint64_t mark() const { return enabled() ? PhaseClock::now() : 0; }
+
+        // Records the time since a mark as phase and returns the mark for
+        // the next phase. Nothing is recorded for a mark taken while
+        // profiling was off.
+        uint64_t lap(LoopPhase phase, uint64_t since)
+        {
+            if (!enabled()) {
+                return 0;
+            }
+            uint64_t now = PhaseClock::now();
+            if (since != 0) {
+                histograms_[size_t(phase)].record(PhaseClock::toNs(now - since));
+            }
+            return now;
+        }
+
+        const LatencyHistogram& histogram(LoopPhase phase) const { return histograms_[size_t(phase)]; }
+        // Not synchronised with lap(): call on the loop's thread or while
+        // disabled
+        void reset();
+
+    private:
+        std::atomic<bool> enabled_{false};
+        LatencyHistogram histograms_[loopPhaseCount];
+};
+
+#endif
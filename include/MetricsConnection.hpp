@@ -0,0 +1,51 @@
+#ifndef METRICS_CONNECTION_H
+#define METRICS_CONNECTION_H
+
+#include <memory>
+#include <string>
+#include "CancellationToken.hpp"
+#include "EventHandler.hpp"
+#include "Reactor.hpp"
+
+// One scrape of the metrics listener: reads an HTTP request, answers
+// GET /metrics in the Prometheus text exposition format, or
+// GET /connections?top=N with the top talkers per dimension, or
+// GET /trace with a Chrome trace of TraceRecorder's rings, and closes.
+// Register it with EPOLLOUT: large answers are sent from handleWrite.
+// Runs on the reactor thread like any other handler, so reading
+// reactor-only state (timers, loop histograms) needs no locking. The
+// trace, megabytes of JSON, is formatted on a worker instead.
+class MetricsConnection : public EventHandler,
+                          public std::enable_shared_from_this<MetricsConnection> {
+    public:
+        MetricsConnection(int fd, Reactor* reactor)
+            : fd_(fd), reactor_(reactor) {}
+
+        int getHandle() const override { return fd_; }
+
+        void handleRead() override;
+        void handleWrite() override;
+        void handleClose() override;
+
+    private:
+        // Requests are a request line and a few headers
+        static constexpr size_t maxRequest_ = 8192;
+
+        int fd_;
+        Reactor* reactor_;
+        std::string request_;
+        std::string response_;
+        size_t sent_ = 0;
+        bool responding_ = false;
+        // Cancelled on close so a pending trace export is dropped
+        CancellationSource cancel_;
+
+        void respond();
+        void reply(const std::string& status, const std::string& type, const std::string& body);
+        void flush();
+};
+
+// Current metrics of reactor, Prometheus text format
+std::string renderMetrics(Reactor& reactor);
+
+#endif
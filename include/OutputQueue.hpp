@@ -0,0 +1,44 @@
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+#include "SharedBuffer.hpp"
+
+// A connection's pending output as a list of SharedBuffer references.
+// Shared messages are queued without copying their bytes and a whole
+// backlog leaves in one gather write (sendmsg, i.e. writev that does not
+// raise SIGPIPE), up to maxIov segments per call. The vector keeps its
+// capacity once drained, so steady state does not allocate.
+class OutputQueue
+{
+    public:
+        static constexpr int maxIov = 64;
+
+        void append(SharedBuffer buffer);
+        // Bytes only this connection sends, such as replies; one copy
+        void append(std::string_view bytes) { append(SharedBuffer::copyOf(bytes)); }
+
+        bool empty() const { return head_ == segments_.size(); }
+        // Queued bytes not yet sent
+        size_t bytes() const { return bytes_; }
+        size_t segments() const { return segments_.size() - head_; }
+
+        // Sends until the queue is empty or the socket is full. Returns
+        // the bytes sent, or -1 with errno set on an error other than
+        // EAGAIN.
+        ssize_t writeTo(int fd);
+        void clear();
+
+    private:
+        std::vector<SharedBuffer> segments_;
+        // First unsent segment, and how much of it went out already
+        size_t head_ = 0;
+        size_t headSent_ = 0;
+        size_t bytes_ = 0;
+
+        void consume(size_t n);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT probes under the "reactor" provider. Configured with
+// -DREACTOR_USDT=ON, which needs <sys/sdt.h> (systemtap-sdt-dev /
+// systemtap-sdt-devel) and checks react1's notes after linking, each probe
+// compiles to a single nop plus an ELF note; nothing is linked in and
+// nothing runs until a tracer attaches:
+//
+//     bpftrace -e 'usdt:./react1:reactor:recv { @[arg0] = sum(arg1); }'
+//     perf buildid-cache --add ./react1 && perf list sdt_reactor:*
+//
+// Otherwise, or with REACTOR_NO_PROBES defined, they vanish.
+//
+//   accept          listenFd, clientFd
+//   recv            fd, bytes
+//   conn__close     fd, bytesIn, bytesOut, messagesIn
+//   handler__remove fd, handlers left
+//   task__submit    id, name, cheap (1 if run inline)
+//   task__complete  id, name, ns from submit to continuation, cancelled
+//   timer__fire     id, ms late, interval ms (0 for one-shot)
+//
+// Arguments that cost more than a register move to produce, such as the
+// submit timestamp behind task__complete's latency, are only computed
+// while REACTOR_PROBE_ENABLED(name) says a tracer is attached.
+#if defined(REACTOR_USDT) && !defined(REACTOR_NO_PROBES)
+
+#define REACTOR_HAVE_PROBES 1
+// Every probe gets a semaphore the tracer increments when it attaches
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define REACTOR_PROBE_SEMAPHORE(name) \
+    extern "C" volatile unsigned short reactor_##name##_semaphore \
+        __attribute__((unused)) __attribute__((section(".probes")))
+
+REACTOR_PROBE_SEMAPHORE(accept);
+REACTOR_PROBE_SEMAPHORE(recv);
+REACTOR_PROBE_SEMAPHORE(conn__close);
+REACTOR_PROBE_SEMAPHORE(handler__remove);
+REACTOR_PROBE_SEMAPHORE(task__submit);
+REACTOR_PROBE_SEMAPHORE(task__complete);
+REACTOR_PROBE_SEMAPHORE(timer__fire);
+
+#define REACTOR_PROBE_ENABLED(name) __builtin_expect(reactor_##name##_semaphore != 0, 0)
+#define REACTOR_PROBE2(name, a, b) DTRACE_PROBE2(reactor, name, a, b)
+#define REACTOR_PROBE3(name, a, b, c) DTRACE_PROBE3(reactor, name, a, b, c)
+#define REACTOR_PROBE4(name, a, b, c, d) DTRACE_PROBE4(reactor, name, a, b, c, d)
+
+#else
+
+// sizeof keeps the arguments referenced, so locals that only feed a probe
+// do not warn, without evaluating them
+#define REACTOR_PROBE_ENABLED(name) false
+#define REACTOR_PROBE2(name, a, b) do { (void)sizeof(a); (void)sizeof(b); } while (0)
+#define REACTOR_PROBE3(name, a, b, c) do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); } while (0)
+#define REACTOR_PROBE4(name, a, b, c, d) \
+    do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); (void)sizeof(d); } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef PUB_SUB_H
+#define PUB_SUB_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "SharedBuffer.hpp"
+
+// Something a PubSub topic delivers to, usually a connection
+class Subscriber
+{
+    public:
+        virtual ~Subscriber() = default;
+
+        // Queues message by reference (see OutputQueue). Runs inside
+        // publish, so it must not subscribe or unsubscribe anyone.
+        virtual void deliver(const SharedBuffer& message) = 0;
+        // Sends what deliver queued. Called once per event loop iteration
+        // for every subscriber that got messages, so a burst of publishes
+        // costs each subscriber one write.
+        virtual void flushDeliveries() = 0;
+
+    private:
+        friend class PubSub;
+        std::vector<std::string> topics_;
+        bool flushPending_ = false;
+};
+
+// Topics of the reactor (Reactor::pubsub). A published message is one
+// SharedBuffer whose reference is handed to every subscriber of the
+// topic; nothing is copied per recipient. Reactor thread only.
+class PubSub
+{
+    public:
+        // False if s already subscribes to topic
+        bool subscribe(std::string_view topic, Subscriber* s);
+        bool unsubscribe(std::string_view topic, Subscriber* s);
+        // Call before s is destroyed; also cancels its pending flush
+        void unsubscribeAll(Subscriber* s);
+
+        // Returns the number of subscribers message was queued for
+        size_t publish(std::string_view topic, const SharedBuffer& message);
+        size_t publish(std::string_view topic, std::string_view message)
+        {
+            return publish(topic, SharedBuffer::copyOf(message));
+        }
+
+        size_t subscribers(std::string_view topic) const;
+        size_t topics() const { return topics_.size(); }
+
+        // Run by the reactor at the end of each loop iteration
+        bool hasPending() const { return !pending_.empty(); }
+        void flushPending();
+
+    private:
+        std::map<std::string, std::vector<Subscriber*>, std::less<>> topics_;
+        // Subscribers with deliveries not flushed yet; flushing_ is the
+        // batch being flushed, both keep their capacity
+        std::vector<Subscriber*> pending_;
+        std::vector<Subscriber*> flushing_;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef PUB_SUB_CONNECTION_HANDLER_H
+#define PUB_SUB_CONNECTION_HANDLER_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include "EventHandler.hpp"
+#include "OutputQueue.hpp"
+#include "PubSub.hpp"
+#include "Reactor.hpp"
+
+// Line protocol over the reactor's PubSub, for chat rooms and the like:
+//
+//     SUB topic           -> "subscribed topic"
+//     UNSUB topic         -> "unsubscribed topic"
+//     PUB topic text      -> "published N" (N subscribers reached)
+//
+// and every subscriber of the topic receives "topic: text". Such a
+// message is built once and queued by reference on each subscriber's
+// OutputQueue; all of a subscriber's messages of one loop iteration then
+// leave in a single gather write.
+//
+// Register it with EPOLLOUT. Reading stops while maxQueued_ bytes are
+// queued and resumes as they drain, so a client that pipelines commands
+// without reading the replies cannot grow the queue without bound. A
+// subscriber that lets more than maxQueued_ bytes pile up is disconnected
+// instead of buffering forever.
+class PubSubConnectionHandler : public EventHandler, public Subscriber,
+                                public std::enable_shared_from_this<PubSubConnectionHandler> {
+    public:
+        PubSubConnectionHandler(int fd, Reactor* reactor)
+            : fd_(fd), reactor_(reactor), stats_(reactor->connectionStats().open(fd))
+        {
+            reactor_->metrics().connectionsOpened.add();
+        }
+
+        int getHandle() const override { return fd_; }
+
+        void handleRead() override;
+        void handleWrite() override;
+        void handleClose() override;
+
+        void deliver(const SharedBuffer& message) override;
+        void flushDeliveries() override;
+
+    private:
+        static constexpr size_t readSize_ = 4096;
+        static constexpr size_t maxLine_ = 64 * 1024;
+        static constexpr size_t maxQueued_ = 8 << 20;
+
+        int fd_;
+        Reactor* reactor_;
+        ConnectionStatsTable::Slot stats_;
+        std::string inputBuffer_;
+        OutputQueue output_;
+        bool removed_ = false;
+        // Close once queued output is sent, after a bad line
+        bool closing_ = false;
+        // Over maxQueued_: close at the next flushDeliveries
+        bool overflowed_ = false;
+        // handleRead stopped at maxQueued_; pick up again once it drains
+        bool readPaused_ = false;
+
+        void execute(std::string_view line);
+        void reply(std::string_view verb, std::string_view argument);
+        // False once the handler was removed
+        bool flush();
+        void resumeReading();
+        ConnectionStats& stats() { return reactor_->connectionStats()[stats_]; }
+};
+
+#endif
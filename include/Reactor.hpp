@@ -1,61 +1,302 @@
 #ifndef REACTOR_H
 #define REACTOR_H
 
+#include <atomic>
 #include <chrono>
+#include <coroutine>
+#include <functional>
 #include <map>
-#include <queue>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <unistd.h>
+#include "Completion.hpp"
+#include "ConnectionStats.hpp"
+#include "CancelScope.hpp"
+#include "CoroTask.hpp"
+#include "FramePool.hpp"
 #include "EventHandler.hpp"
+#include "LoopProfiler.hpp"
+#include "Probes.hpp"
+#include "PubSub.hpp"
+#include "ReactorMetrics.hpp"
+#include "StallWatchdog.hpp"
 #include "Task.hpp"
+#include "TaskTrace.hpp"
 #include "Timer.hpp"
+#include "TraceRecorder.hpp"
 #include "WorkerPool.hpp"
 
+// Coroutines suspended on an fd, plus readiness nobody has consumed yet
+struct IoWaiter
+{
+    std::coroutine_handle<> reader;
+    std::coroutine_handle<> writer;
+    bool readReady = false;
+    bool writeReady = false;
+};
+
 using HandlerMap = std::unordered_map<int, EventHandlerPtr>;
-using TimerMap = std::map<uint64_t, std::vector<Timer>>;
+using IoWaiterMap = std::unordered_map<int, IoWaiter>;
+// By expiry; timers due in the same millisecond fire in the order they
+// were added
+using TimerMap = std::multimap<uint64_t, Timer>;
 
 class Reactor {
     public:
-        Reactor();
-        void registerHandler(EventHandlerPtr handler);
+        Reactor(size_t workers = 2, IdleStrategy idle = IdleStrategy{});
+        // Handlers that buffer output also want EPOLLOUT for handleWrite
+        void registerHandler(EventHandlerPtr handler, uint32_t events = EPOLLIN | EPOLLET);
         void removeHandler(int handle);
         void eventLoop();
+        void stop();
         int addTimer(uint64_t ms, bool recurring, std::function<void()> cb);
+        // One-shot timer that resumes waiter
+        int addTimer(uint64_t ms, std::coroutine_handle<> waiter);
+        // False if the timer already fired (one-shot) or never existed
+        bool cancelTimer(int id);
+
+        // Runs taskFn on a worker and then continuation(result) on the
+        // reactor thread. Both callables are forwarded into one completion
+        // slot, the only allocation of the round trip. A continuation taking
+        // TaskResult<T> also receives exceptions thrown by taskFn.
         template<typename TaskFn, typename Continuation>
             void submitTask(TaskFn&& taskFn, Continuation&& continuation)
             {
+                submitTask(TaskOptions{}, std::forward<TaskFn>(taskFn),
+                           std::forward<Continuation>(continuation));
+            }
+
+        // As above. Once opts.cancel is cancelled a queued task is dropped
+        // without running and the continuation is never called. Tasks are
+        // run earliest opts.deadline first; one still queued at its deadline
+        // is skipped and the continuation gets DeadlineExceeded instead.
+        // With opts.cheap both callables run before submitTask returns, so
+        // this must be called from the reactor thread.
+        template<typename TaskFn, typename Continuation>
+            void submitTask(TaskOptions opts, TaskFn&& taskFn, Continuation&& continuation)
+            {
+                using Slot = TypedCompletion<std::decay_t<TaskFn>,
+                                             std::decay_t<Continuation>>;
+
+                if (opts.cheap) {
+                    // Same slot, but on the stack: no allocation, no thread hop
+                    Slot slot(opts.cancel, std::forward<TaskFn>(taskFn),
+                              std::forward<Continuation>(continuation));
+                    metrics_.tasksInline.add();
+                    slot.name = opts.name;
+                    if (REACTOR_PROBE_ENABLED(task__complete)) {
+                        slot.submittedNs = probeNowNs();
+                    }
+                    REACTOR_PROBE3(task__submit, uintptr_t(&slot), opts.name, 1);
+                    runInline(slot, opts.deadline);
+                    return;
+                }
+
+                Completion* c = new Slot(opts.cancel,
+                                         std::forward<TaskFn>(taskFn),
+                                         std::forward<Continuation>(continuation));
+
+                c->name = opts.name;
+                c->trace = tracer_.start(opts.name);
+                if (REACTOR_PROBE_ENABLED(task__complete)) {
+                    c->submittedNs = probeNowNs();
+                }
+                REACTOR_PROBE3(task__submit, uintptr_t(c), opts.name, 0);
+
+                if (TraceRecorder::enabled()) {
+                    c->flowId = ++lastFlowId_;
+                    TraceRecorder::flow('s', opts.name, c->flowId, TraceRecorder::now());
+                }
+
                 Task task;
-                task.fn = [taskFn, continuation, this]() {
-                    auto result = taskFn();
-                    std::lock_guard<std::mutex> lock(completedMtx_);
-                    completed_.push([result, continuation]() {
-                            continuation(result);
-                            });
-
-                    // wake up reactor
-                    uint64_t one = 1;
-                    write(eventFd_, &one, sizeof(one));
+                task.fn = [c, this]() { runOnWorker(c); };
+                // The continuation may hold the last reference to its
+                // owner, so it is destroyed on the reactor thread too
+                task.onDrop = [c, this](DropReason reason) {
+                    if (reason == DropReason::DeadlineMissed) {
+                        c->fail(std::make_exception_ptr(DeadlineExceeded()));
+                    }
+                    postCompletion(c);
                 };
-                workerPool_.submit(task);
+                task.cancel = std::move(opts.cancel);
+                task.deadline = opts.deadline;
+                metrics_.tasksSubmitted.add();
+                workerPool_.submit(std::move(task));
+            }
+
+        WorkerPoolStats workerStats() const { return workerPool_.stats(); }
+        ReactorMetrics& metrics() { return metrics_; }
+        // Per-connection traffic, reactor thread only
+        ConnectionStatsTable& connectionStats() { return connectionStats_; }
+        // Topics shared by this reactor's connections, reactor thread only.
+        // Subscribers with new messages are flushed at the end of each
+        // loop iteration.
+        PubSub& pubsub() { return pubsub_; }
+
+        // Queue/service/completion histograms per TaskOptions::name for one
+        // in every n worker-bound submitTask calls; 0 turns it off. The
+        // histograms are reactor-thread state.
+        void setTaskTracing(uint32_t sampleEvery) { tracer_.setSampleEvery(sampleEvery); }
+        const TaskTracer& taskTracer() const { return tracer_; }
+
+        // Starts a thread that reports, with a stack sample of the loop,
+        // any handler, timer or continuation that keeps eventLoop busy
+        // longer than threshold. Zero stops it.
+        void setStallWatchdog(std::chrono::milliseconds threshold);
+        uint64_t stallCount() const { return watchdog_ ? watchdog_->stalls() : 0; }
+        // Pending timers; reactor thread only
+        size_t timerCount() const { return timerIndex_.size(); }
+
+        // Suspends the awaiting coroutine until fd is readable (or writable)
+        // and resumes it straight from eventLoop's dispatch. Readiness seen
+        // while nobody waits is remembered, so awaiting after a short read
+        // never misses an edge. Only the reactor thread may await these.
+        // A cancelled CancelScope resumes it with OperationCancelled.
+        class IoAwaiter
+        {
+            public:
+                IoAwaiter(Reactor* reactor, int fd, bool write)
+                    : reactor_(reactor), fd_(fd), write_(write) {}
+                // A coroutine destroyed while suspended is forgotten
+                ~IoAwaiter();
+                bool await_ready();
+                template<typename Promise>
+                    bool await_suspend(std::coroutine_handle<Promise> h)
+                    {
+                        return suspend(h, coro_detail::cancelScopeOf(h));
+                    }
+                void await_resume();
+            private:
+                Reactor* reactor_;
+                int fd_;
+                bool write_;
+                bool cancelled_ = false;
+                CancelScope* scope_ = nullptr;
+                std::coroutine_handle<> waiting_;
+                bool suspend(std::coroutine_handle<> h, CancelScope* scope);
+                static void cancel(void* self);
+        };
+
+        // co_await reactor.sleep(ms): resumes the coroutine from
+        // processTimers; the timer entry holds its handle, nothing else
+        class SleepAwaiter
+        {
+            public:
+                SleepAwaiter(Reactor* reactor, uint64_t ms)
+                    : reactor_(reactor), ms_(ms) {}
+                // A coroutine destroyed while asleep takes its timer along
+                ~SleepAwaiter();
+                bool await_ready() { return false; }
+                template<typename Promise>
+                    bool await_suspend(std::coroutine_handle<Promise> h)
+                    {
+                        return suspend(h, coro_detail::cancelScopeOf(h));
+                    }
+                void await_resume();
+            private:
+                Reactor* reactor_;
+                uint64_t ms_;
+                int timerId_ = -1;
+                bool cancelled_ = false;
+                CancelScope* scope_ = nullptr;
+                std::coroutine_handle<> waiting_;
+                bool suspend(std::coroutine_handle<> h, CancelScope* scope);
+                static void cancel(void* self);
+        };
+
+        IoAwaiter readable(int fd) { return IoAwaiter(this, fd, false); }
+        IoAwaiter writable(int fd) { return IoAwaiter(this, fd, true); }
+        SleepAwaiter sleep(uint64_t ms) { return SleepAwaiter(this, ms); }
+        // fds awaited through readable()/writable() are watched on first
+        // use; unwatch before closing them
+        void watchIo(int fd);
+        void unwatchIo(int fd);
+
+        // Building blocks for awaitables such as AsyncWork. postToWorkers
+        // queues a raw task; resumeOnReactor may be called from any thread
+        // and resumes h from the reactor's completion processing.
+        void postToWorkers(Task task)
+        {
+            metrics_.tasksSubmitted.add();
+            workerPool_.submit(std::move(task));
+        }
+        void resumeOnReactor(std::coroutine_handle<> h);
+
+        // Coroutine frames created on the reactor thread come from here
+        FramePool& framePool() { return framePool_; }
+
+        // Per-phase eventLoop timings; setLoopProfiling may be called from
+        // any thread and the histograms read while the loop runs
+        void setLoopProfiling(bool on) { profiler_.enable(on); }
+        const LoopProfiler& loopProfiler() const { return profiler_; }
+
+        // Starts a coroutine on the reactor thread; its frame is freed when
+        // it finishes
+        template<typename T>
+            void spawn(CoroTask<T> task)
+            {
+                task.startDetached();
             }
     private:
         int epollFd_;
         int eventFd_;
         HandlerMap handlers_;
+        IoWaiterMap ioWaiters_;
         TimerMap timers_;
+        // Live timers by id, pointing at their node in timers_, so a
+        // cancel does not scan the other timers due in the same ms
+        std::unordered_map<int, TimerMap::iterator> timerIndex_;
         int nextTimerId_ = 0;
-        void registerEpollEvent(int fd);
+        // Flow ids of submitted tasks, reactor thread only
+        uint64_t lastFlowId_ = 0;
+        void registerEpollEvent(int fd, uint32_t events = EPOLLIN | EPOLLET);
+        void resumeIo(int fd, uint32_t events);
         int computeNextTimerTimeout();
         void processCompletedTasks();
+        void postCompletion(Completion* c);
+        void runOnWorker(Completion* c);
+        // Publishes what the loop runs next, for the watchdog and traces
+        void enter(LoopActivity kind, uintptr_t id, const char* name = nullptr);
+        void runInline(Completion& c, TaskClock::time_point deadline);
+        void wakeup();
         void processTimers();
+        void insertTimer(Timer t);
         uint64_t nowMs();
-        WorkerPool workerPool_;
-        std::queue<std::function<void()>> completed_;
+        static uint64_t probeNowNs();
+        void probeComplete(Completion& c);
+        // Workers append, the reactor swaps with draining_ and runs them;
+        // both vectors keep their capacity so steady state never allocates
+        std::vector<Completion*> completed_;
+        std::vector<Completion*> draining_;
+        // Coroutines to resume, filled and drained alongside completed_
+        std::vector<std::coroutine_handle<>> resumable_;
+        std::vector<std::coroutine_handle<>> resuming_;
         std::mutex completedMtx_;
+        std::atomic<bool> stopped_{false};
+        FramePool framePool_;
+        LoopProfiler profiler_;
+        ReactorMetrics metrics_;
+        ConnectionStatsTable connectionStats_;
+        PubSub pubsub_;
+        TaskTracer tracer_;
+        LoopActivityState activity_;
+        // The activity whose trace slice is open, while tracing
+        LoopActivity tracedKind_ = LoopActivity::Idle;
+        uintptr_t tracedId_ = 0;
+        const char* tracedName_ = nullptr;
+        uint64_t tracedSince_ = 0;
+        // Reads activity_, so declared after it
+        std::unique_ptr<StallWatchdog> watchdog_;
+        // Declared last so workers are joined before the completion queue
+        // they post to is destroyed
+        WorkerPool workerPool_;
 };
 
 #endif
@@ -0,0 +1,24 @@
+#ifndef REACTOR_METRICS_H
+#define REACTOR_METRICS_H
+
+#include "ShardedCounter.hpp"
+
+// Counters bumped by the reactor and its connections, summed only when
+// scraped (see MetricsConnection). Worker-side counts live in
+// WorkerPoolStats.
+struct ReactorMetrics
+{
+    ShardedCounter connectionsOpened;
+    ShardedCounter connectionsClosed;
+    ShardedCounter bytesRead;
+    ShardedCounter bytesWritten;
+    // submitTask/postToWorkers calls that went to the workers
+    ShardedCounter tasksSubmitted;
+    // submitTask calls with TaskOptions::cheap, run on the reactor thread
+    ShardedCounter tasksInline;
+    // PubSub messages published, and the subscribers they reached
+    ShardedCounter messagesPublished;
+    ShardedCounter messagesDelivered;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef RESP_PARSER_H
+#define RESP_PARSER_H
+
+#include <cstddef>
+#include <string_view>
+
+// One client command: a RESP2 array of bulk strings, or an inline command
+// (words separated by spaces, as typed into telnet). Every view points
+// into the buffer given to RespParser::parse.
+struct RespCommand
+{
+    static constexpr size_t maxArgs = 256;
+
+    std::string_view args[maxArgs];
+    size_t argc = 0;
+};
+
+// Parses client commands in place, without allocating. A pipelined batch
+// is parsed by calling parse() at successive offsets until it returns
+// Incomplete; the partial command is parsed again from its start once
+// more bytes arrive, which bulk lengths make cheap.
+class RespParser
+{
+    public:
+        enum class Status { Complete, Incomplete, Error };
+
+        static constexpr size_t maxBulk = 8 << 20;
+        // Longest inline command line
+        static constexpr size_t maxInline = 64 << 10;
+
+        Status parse(const char* data, size_t len, RespCommand& cmd);
+
+        // Bytes of the Complete command; an empty inline line is a
+        // command with no arguments
+        size_t consumed() const { return consumed_; }
+        // Reason for an Error, sent back as -ERR
+        const char* error() const { return error_; }
+
+    private:
+        size_t consumed_ = 0;
+        const char* error_ = "";
+
+        Status parseInline(const char* data, size_t len, RespCommand& cmd);
+        Status fail(const char* error);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Monotonic counter for hot paths written by several threads. Each thread
+// gets its own cache line, so add() is an uncontended load+store and
+// threads never bounce a line between cores. value() sums the shards and
+// is only meant for scrapes and stats.
+//
+// The first maxOwners threads of the process own a shard each; any later
+// thread shares one overflow shard through fetch_add.
+class ShardedCounter
+{
+    public:
+        static constexpr size_t maxOwners = 64;
+
+        void add(uint64_t n = 1)
+        {
+            size_t slot = threadSlot();
+            if (slot < maxOwners) {
+                auto& v = shards_[slot].value;
+                v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            } else {
+                shards_[maxOwners].value.fetch_add(n, std::memory_order_relaxed);
+            }
+        }
+
+        uint64_t value() const
+        {
+            uint64_t sum = 0;
+            for (const auto& s : shards_) {
+                sum += s.value.load(std::memory_order_relaxed);
+            }
+            return sum;
+        }
+
+    private:
+        struct alignas(64) Shard
+        {
+            std::atomic<uint64_t> value{0};
+        };
+
+        static size_t threadSlot()
+        {
+            static std::atomic<size_t> nextSlot{0};
+            thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+            return slot;
+        }
+
+        Shard shards_[maxOwners + 1];
+};
+
+#endif
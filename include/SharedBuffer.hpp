@@ -0,0 +1,69 @@
+#ifndef SHARED_BUFFER_H
+#define SHARED_BUFFER_H
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <utility>
+
+// Immutable bytes shared by reference: one allocation holding an 8-byte
+// header and the bytes, freed with the last reference. A copy only bumps
+// the count, so a message queued for thousands of connections exists
+// once. The count is not atomic; reactor thread only. Up to 4 GiB.
+class SharedBuffer
+{
+    public:
+        SharedBuffer() = default;
+
+        static SharedBuffer copyOf(std::string_view bytes)
+        {
+            SharedBuffer buffer;
+            void* memory = ::operator new(sizeof(Block) + bytes.size());
+            buffer.block_ = new (memory) Block{1, uint32_t(bytes.size())};
+            if (!bytes.empty()) {
+                std::memcpy(buffer.block_ + 1, bytes.data(), bytes.size());
+            }
+            return buffer;
+        }
+
+        SharedBuffer(const SharedBuffer& other) : block_(other.block_)
+        {
+            if (block_) {
+                block_->refs++;
+            }
+        }
+
+        SharedBuffer(SharedBuffer&& other) noexcept
+            : block_(std::exchange(other.block_, nullptr)) {}
+
+        SharedBuffer& operator=(SharedBuffer other) noexcept
+        {
+            std::swap(block_, other.block_);
+            return *this;
+        }
+
+        ~SharedBuffer()
+        {
+            if (block_ && --block_->refs == 0) {
+                ::operator delete(block_);
+            }
+        }
+
+        const char* data() const { return block_ ? reinterpret_cast<const char*>(block_ + 1) : nullptr; }
+        size_t size() const { return block_ ? block_->size : 0; }
+        bool empty() const { return size() == 0; }
+        std::string_view view() const { return std::string_view(data(), size()); }
+        uint32_t useCount() const { return block_ ? block_->refs : 0; }
+
+    private:
+        struct Block
+        {
+            uint32_t refs;
+            uint32_t size;
+        };
+
+        Block* block_ = nullptr;
+};
+
+#endif
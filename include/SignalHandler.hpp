@@ -0,0 +1,29 @@
+#ifndef SIGNAL_HANDLER_H
+#define SIGNAL_HANDLER_H
+
+#include <functional>
+#include <signal.h>
+#include "EventHandler.hpp"
+#include "Reactor.hpp"
+
+// Delivers a signal through a signalfd, so its callback runs on the
+// reactor thread like any other event and may do anything a handler may.
+// The signal must be blocked in every thread (pthread_sigmask before any
+// thread is started, see blockSignal) or it is delivered the usual way.
+class SignalHandler : public EventHandler {
+    public:
+        SignalHandler(int signo, std::function<void()> onSignal);
+
+        int getHandle() const override { return fd_; }
+
+        void handleRead() override;
+
+        // Blocks signo in the calling thread and the threads it starts
+        static void blockSignal(int signo);
+
+    private:
+        int fd_;
+        std::function<void()> onSignal_;
+};
+
+#endif
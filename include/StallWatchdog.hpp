@@ -0,0 +1,102 @@
+#ifndef STALL_WATCHDOG_H
+#define STALL_WATCHDOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+
+// What the reactor thread is running, for blame when it stalls
+enum class LoopActivity : uint32_t { Idle, Handler, Io, Timer, Completion, Coroutine };
+const char* loopActivityName(LoopActivity activity);
+
+// Published by the reactor thread with relaxed stores before each unit of
+// work; read by StallWatchdog. A reader may pair one activity's kind with
+// the next one's id, which only matters if the loop is not stalled.
+struct LoopActivityState
+{
+    std::atomic<uint64_t> seq{0};
+    std::atomic<LoopActivity> kind{LoopActivity::Idle};
+    // fd, timer id, or address of the completion or coroutine
+    std::atomic<uintptr_t> id{0};
+    // Task name of a completion
+    std::atomic<const char*> name{nullptr};
+
+    // The thread inside eventLoop, if any. The watchdog signals it only
+    // under threadMtx, so it cannot leave the loop, and perhaps exit,
+    // between the check and the signal.
+    mutable std::mutex threadMtx;
+    bool looping = false;
+    pthread_t thread{};
+
+    void begin(LoopActivity k, uintptr_t what, const char* label = nullptr)
+    {
+        kind.store(k, std::memory_order_relaxed);
+        id.store(what, std::memory_order_relaxed);
+        name.store(label, std::memory_order_relaxed);
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void enterLoop()
+    {
+        std::lock_guard<std::mutex> lock(threadMtx);
+        thread = pthread_self();
+        looping = true;
+    }
+
+    void leaveLoop()
+    {
+        std::lock_guard<std::mutex> lock(threadMtx);
+        looping = false;
+    }
+};
+
+// Thread that polls a LoopActivityState and reports on stderr when one
+// activity (anything but Idle, i.e. epoll_wait) runs longer than
+// threshold: what was running and a stack sample of the reactor thread,
+// taken by interrupting it with stackSignal. Reported once per stall,
+// with a second line when the loop moves on.
+//
+// The signal handler only calls backtrace(), which POSIX does not list as
+// async-signal-safe. glibc's is safe enough once warmed up (the watchdog
+// does that before installing the handler, so libgcc is already loaded and
+// nothing allocates), but it still walks the loaded objects under the
+// dynamic loader's lock: a stall inside dlopen() or dl_iterate_phdr() would
+// deadlock the reactor thread on the sample. Frames are symbolized on the
+// watchdog thread. The previous handler for stackSignal is restored on
+// destruction, unless a sample went unanswered and its signal may still
+// arrive.
+class StallWatchdog
+{
+    public:
+        StallWatchdog(const LoopActivityState& activity, std::chrono::milliseconds threshold,
+                      int stackSignal = SIGUSR2);
+        ~StallWatchdog();
+        StallWatchdog(const StallWatchdog&) = delete;
+        StallWatchdog& operator=(const StallWatchdog&) = delete;
+
+        uint64_t stalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+    private:
+        const LoopActivityState& activity_;
+        std::chrono::milliseconds threshold_;
+        int stackSignal_;
+        struct sigaction oldAction_ {};
+        // A stack signal was sent but not taken in time; it may still land
+        bool sampleUnanswered_ = false;
+        std::atomic<uint64_t> stalls_{0};
+        bool stop_ = false;
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        std::thread thread_;
+
+        void run();
+        void report(std::chrono::milliseconds stalledFor);
+        void dumpStack();
+};
+
+#endif
@@ -1,8 +1,42 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include "CancellationToken.hpp"
+
+using TaskClock = std::chrono::steady_clock;
+
+enum class DropReason
+{
+    Cancelled,
+    DeadlineMissed
+};
+
 struct Task
 {
     std::function<void()> fn;
+    // Checked by the worker before fn runs; a cancelled or expired task is
+    // not run and onDrop is called instead so its owner can release resources
+    CancellationToken cancel;
+    std::function<void(DropReason)> onDrop;
+    // Workers run the earliest deadline first; no deadline sorts last
+    TaskClock::time_point deadline = TaskClock::time_point::max();
+    // Assigned by TaskQueue, keeps equal deadlines in FIFO order
+    uint64_t seq = 0;
+};
+
+// Per-submission knobs for Reactor::submitTask
+struct TaskOptions
+{
+    CancellationToken cancel;
+    TaskClock::time_point deadline = TaskClock::time_point::max();
+    // The work costs less than the handoff to a worker (queue lock, wakeup,
+    // eventfd, epoll): run it and the continuation on the reactor thread
+    bool cheap = false;
+    // Groups sampled traces per task type (see TaskTracer); must outlive
+    // the reactor, in practice a string literal
+    const char* name = "task";
 };
 #endif
@@ -1,20 +1,37 @@
 #ifndef TASK_QUEUE_H
 #define TASK_QUEUE_H
 
-#include <queue>
+#include <atomic>
+#include <cstdint>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 #include "Task.hpp"
 
+// Earliest-deadline-first queue. Tasks without a deadline keep FIFO order
+// among themselves and only run when no deadline task is waiting, so a
+// steady stream of deadline work can starve them.
 class TaskQueue
 {
     public:
         void push(Task t);
+        // Blocks until a task is available
         Task pop();
+        // Never blocks; checks a lock-free size hint first, so callers can
+        // poll it in a spin loop without hammering the mutex
+        bool tryPop(Task& out);
+        // Lock-free hint, may lag a concurrent push or pop
+        size_t size() const { return size_.load(std::memory_order_relaxed); }
     private:
-        std::queue<Task> queue_;
+        // Binary heap in a vector: reuses its capacity, so steady state
+        // does not allocate
+        std::vector<Task> heap_;
+        std::atomic<size_t> size_{0};
+        uint64_t nextSeq_ = 0;
         std::mutex mtx_;
         std::condition_variable cv_;
+        Task takeTop();
+        static bool runsLater(const Task& a, const Task& b);
 };
 
 #endif
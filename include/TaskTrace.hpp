@@ -0,0 +1,104 @@
+#ifndef TASK_TRACE_H
+#define TASK_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "LatencyHistogram.hpp"
+#include "LoopProfiler.hpp"
+
+// Timestamps (PhaseClock ticks) of one sampled submitTask round trip
+struct TaskTrace
+{
+    const char* name;
+    uint64_t submitted = 0;
+    // Worker picked it up and is about to run it
+    uint64_t dequeued = 0;
+    uint64_t finished = 0;
+    // Pushed onto the reactor's completion queue
+    uint64_t enqueued = 0;
+};
+
+// Legs of a round trip, each with its own histogram per task type:
+// Queue is time in the TaskQueue (a saturated pool), Service the task
+// itself (slow work), Handoff getting the result onto the completion
+// queue, Completion the wait for the reactor to run the continuation
+// (reactor-side lag) and Total the whole trip.
+enum class TaskLeg { Queue, Service, Handoff, Completion, Total };
+constexpr size_t taskLegCount = 5;
+const char* taskLegName(TaskLeg leg);
+
+struct TaskTypeTrace
+{
+    LatencyHistogram legs[taskLegCount];
+};
+
+// Samples one in N submitTask calls, on average. Unsampled tasks pay one
+// load of N; sampled worker-bound ones allocate a TaskTrace and read the
+// clock five times. Inline (cheap) tasks are sampled too, with their trace
+// on the stack: their queue, handoff and completion legs are near zero and
+// service is the time the task itself took on the reactor thread.
+class TaskTracer
+{
+    public:
+        // 0 turns tracing off; callable from any thread
+        void setSampleEvery(uint32_t n);
+        uint32_t sampleEvery() const { return sampleEvery_.load(std::memory_order_acquire); }
+
+        // Whether to trace this submission
+        bool sample()
+        {
+            uint32_t every = sampleEvery();
+            return every != 0 && (every == 1 || nextRandom() % every == 0);
+        }
+
+        // A trace for this submission, or null if it is not sampled
+        std::unique_ptr<TaskTrace> start(const char* name)
+        {
+            if (!sample()) {
+                return nullptr;
+            }
+            auto trace = std::make_unique<TaskTrace>();
+            trace->name = name;
+            trace->submitted = PhaseClock::now();
+            return trace;
+        }
+
+        // Called on the reactor thread as the continuation is about to run
+        void record(const TaskTrace& trace, uint64_t now);
+
+        // Names are looked up as string_views, so recording a sample does
+        // not build a std::string
+        struct NameHash
+        {
+            using is_transparent = void;
+            size_t operator()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+        };
+        using TypeMap = std::unordered_map<std::string, std::unique_ptr<TaskTypeTrace>,
+                                           NameHash, std::equal_to<>>;
+
+        // Reactor thread only; keyed by TaskOptions::name
+        const TypeMap& types() const { return types_; }
+
+    private:
+        // Random rather than every n-th, which would alias with any
+        // workload that alternates task types
+        static uint64_t nextRandom()
+        {
+            thread_local uint64_t state = 0x9e3779b97f4a7c15ull ^ reinterpret_cast<uintptr_t>(&state);
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+
+        std::atomic<uint32_t> sampleEvery_{0};
+        TypeMap types_;
+};
+
+#endif
@@ -1,12 +1,18 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+
 struct Timer 
 {
     int id;
     uint64_t expiresAt;
     uint64_t interval;
     std::function<void()> callback;
+    // Resumed instead of callback when set (Reactor::sleep)
+    std::coroutine_handle<> waiter;
 };
 
 #endif
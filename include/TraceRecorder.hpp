@@ -0,0 +1,72 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "LoopProfiler.hpp"
+
+// One timeline event; names are string literals (or otherwise immortal)
+struct TraceEvent
+{
+    const char* category;
+    const char* name;
+    uint64_t start;
+    // Ticks for slices ('X'), 0 otherwise
+    uint64_t duration;
+    // fd, timer id, or flow id
+    uint64_t arg;
+    // Chrome trace phase: 'X' slice, 'i' instant, 's'/'t'/'f' flow
+    char phase;
+};
+
+// Process-wide recorder of reactor and worker activity for chrome://tracing
+// and Perfetto. Each thread appends to its own ring buffer, so recording
+// is a clock read and a few stores with no locking and no sharing; when a
+// ring is full the oldest events are overwritten. Export walks all rings,
+// including those of threads that have exited, and may run while threads
+// keep recording: events overwritten during the copy are left out.
+class TraceRecorder
+{
+    public:
+        // Rings are sized on first use by each thread
+        static void enable(size_t eventsPerThread = size_t(1) << 16);
+        static void disable();
+        static bool enabled() { return enabled_.load(std::memory_order_acquire); }
+
+        static uint64_t now() { return PhaseClock::now(); }
+        static void slice(const char* category, const char* name, uint64_t start, uint64_t end, uint64_t arg = 0)
+        {
+            record(TraceEvent{category, name, start, end > start ? end - start : 0, arg, 'X'});
+        }
+        static void instant(const char* category, const char* name, uint64_t arg = 0)
+        {
+            record(TraceEvent{category, name, now(), 0, arg, 'i'});
+        }
+        // Arrows between slices on different threads: start ('s'), step
+        // ('t') and finish ('f') share an id and bind to the slice that
+        // encloses their timestamp
+        static void flow(char phase, const char* name, uint64_t id, uint64_t at)
+        {
+            record(TraceEvent{"flow", name, at, 0, id, phase});
+        }
+
+        // Labels the calling thread's track; name must outlive the trace
+        static void setThreadName(const char* name);
+
+        // Formatting a full set of rings takes long enough to stall an
+        // event loop; call it from a worker
+        static void writeChromeTrace(std::ostream& out);
+        // False if path cannot be written
+        static bool writeChromeTrace(const std::string& path);
+
+    private:
+        static void record(const TraceEvent& e);
+
+        static inline std::atomic<bool> enabled_{false};
+        static inline std::atomic<size_t> capacity_{size_t(1) << 16};
+};
+
+#endif
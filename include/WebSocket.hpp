@@ -0,0 +1,61 @@
+#ifndef WEB_SOCKET_H
+#define WEB_SOCKET_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Building blocks of RFC 6455, shared by WebSocketConnectionHandler and
+// bench_websocket. Self-contained: no crypto library for one SHA-1.
+
+// SHA-1 digest of data; only the opening handshake needs it
+std::array<uint8_t, 20> sha1(std::string_view data);
+std::string base64Encode(const uint8_t* data, size_t len);
+// Sec-WebSocket-Accept answering a client's Sec-WebSocket-Key
+std::string webSocketAccept(std::string_view key);
+
+enum class WsOpcode : uint8_t
+{
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA
+};
+
+struct WsFrameHeader
+{
+    bool fin;
+    WsOpcode opcode;
+    bool masked;
+    // The four mask bytes as they appear on the wire, loaded little end first
+    uint32_t maskKey;
+    uint64_t payloadLength;
+    // 2 to 14 bytes
+    size_t headerLength;
+};
+
+enum class WsParse { Complete, Incomplete, Error };
+
+// Parses the frame header at data. Error on reserved bits or opcodes and
+// on malformed control frames; masking is left to the caller to enforce.
+WsParse parseWsFrameHeader(const char* data, size_t len, WsFrameHeader& header);
+
+// Appends an unmasked (server to client) frame with FIN set
+void appendWsFrame(std::string& out, WsOpcode opcode, std::string_view payload);
+
+// XORs len bytes of payload in place with maskKey, for bytes starting at
+// offset within the frame's payload, so a payload can be unmasked piece
+// by piece as it arrives. Runs the widest kernel the CPU supports: AVX2
+// (32 bytes per step), SSE2 (16) or 8-byte words.
+void unmaskWs(char* data, size_t len, uint32_t maskKey, uint64_t offset);
+
+// Single kernels, for bench_websocket to compare
+enum class UnmaskKernel { Scalar, Sse2, Avx2 };
+bool unmaskKernelSupported(UnmaskKernel kernel);
+void unmaskWs(char* data, size_t len, uint32_t maskKey, uint64_t offset, UnmaskKernel kernel);
+
+#endif
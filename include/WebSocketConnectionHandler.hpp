@@ -0,0 +1,104 @@
+#ifndef WEB_SOCKET_CONNECTION_HANDLER_H
+#define WEB_SOCKET_CONNECTION_HANDLER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "EventHandler.hpp"
+#include "HttpParser.hpp"
+#include "Reactor.hpp"
+#include "WebSocket.hpp"
+
+class WebSocketConnectionHandler;
+
+// Called on the reactor thread with each complete message. The view is
+// only valid during the call.
+using WebSocketMessageHandler =
+    std::function<void(WebSocketConnectionHandler& conn, std::string_view message, bool binary)>;
+
+// Server side of one WebSocket connection (RFC 6455). Answers the HTTP
+// Upgrade request, then reads frames as they arrive: payloads are
+// unmasked in place with unmaskWs, a frame that is already complete in
+// the input buffer is handed over without a copy, and fragmented or
+// partially received messages are assembled as their bytes come in.
+// Pings are answered and a close is echoed before the connection closes.
+//
+// send() queues an unmasked frame on the same output buffer as
+// everything else; all frames of a read go out with one send. Register
+// it with EPOLLOUT. Text payloads are not checked for valid UTF-8.
+class WebSocketConnectionHandler : public EventHandler,
+                                   public std::enable_shared_from_this<WebSocketConnectionHandler> {
+    public:
+        static constexpr size_t maxMessage = 16 << 20;
+
+        WebSocketConnectionHandler(int fd, Reactor* reactor, WebSocketMessageHandler onMessage)
+            : fd_(fd), reactor_(reactor), onMessage_(std::move(onMessage)),
+              stats_(reactor->connectionStats().open(fd))
+        {
+            reactor_->metrics().connectionsOpened.add();
+        }
+
+        int getHandle() const override { return fd_; }
+
+        void handleRead() override;
+        void handleWrite() override;
+        void handleClose() override;
+
+        // Reactor thread only; sent with the next flush
+        void send(std::string_view message, bool binary = false);
+        // Sends a close frame and closes once it is out (1000 is normal)
+        void close(uint16_t code = 1000);
+
+    private:
+        static constexpr size_t readSize_ = 16384;
+        // Reading pauses while this much output waits for a slow client
+        static constexpr size_t maxOutput_ = 1 << 20;
+        // How long a closing connection waits for the client to hang up
+        static constexpr uint64_t lingerMs_ = 2000;
+
+        enum class State { Handshake, Open, Closing, Lingering };
+
+        int fd_;
+        Reactor* reactor_;
+        WebSocketMessageHandler onMessage_;
+        ConnectionStatsTable::Slot stats_;
+        State state_ = State::Handshake;
+        std::string inputBuffer_;
+        // Bytes before outputSent_ are already sent
+        std::string outputBuffer_;
+        size_t outputSent_ = 0;
+        // Inside handleRead, where send() leaves flushing to the end of the batch
+        bool reading_ = false;
+        bool removed_ = false;
+        int lingerTimer_ = -1;
+
+        // Handshake
+        HttpParser parser_;
+        HttpRequest request_;
+
+        // The frame being received: its header and how much of its
+        // payload is still to come
+        bool inFrame_ = false;
+        WsFrameHeader frame_{};
+        uint64_t frameReceived_ = 0;
+        // Data frames so far of a message that is fragmented or has not
+        // fully arrived, and the payload of a control frame
+        std::string message_;
+        bool messageBinary_ = false;
+        bool messageOpen_ = false;
+        std::string control_;
+
+        // Return how many input bytes were used
+        size_t handshake();
+        size_t parseFrames(char* data, size_t len);
+        void frameDone();
+        void deliver(std::string_view message, bool binary);
+        void protocolError(uint16_t code);
+        bool flush();
+        void linger();
+        ConnectionStats& stats() { return reactor_->connectionStats()[stats_]; }
+};
+
+#endif
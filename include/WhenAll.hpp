@@ -0,0 +1,118 @@
+#ifndef WHEN_ALL_H
+#define WHEN_ALL_H
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "Completion.hpp"
+#include "Reactor.hpp"
+#include "Task.hpp"
+
+template<typename Fn>
+using BranchResult = std::remove_cvref_t<std::invoke_result_t<Fn&>>;
+
+// void branches show up as std::monostate in the result tuple
+template<typename Fn>
+using BranchValue = std::conditional_t<std::is_void_v<BranchResult<Fn>>,
+      std::monostate, BranchResult<Fn>>;
+
+// Awaitable that runs every callable on a worker at once and resumes the
+// awaiting coroutine a single time, on the reactor thread, when the last
+// one finishes:
+//
+//     auto [a, b] = co_await whenAll(reactor, [] { return f(); }, [] { return g(); });
+//
+// Like AsyncWork all state lives in the awaiter, inside the coroutine
+// frame, and each branch is handed a pointer to it: no allocation. If
+// branches throw, the first exception (by position) is rethrown once all
+// of them are done.
+template<typename... Fns>
+class WhenAll
+{
+    public:
+        using Result = std::tuple<BranchValue<Fns>...>;
+
+        template<typename... Fs>
+            WhenAll(Reactor& reactor, Fs&&... fns)
+            : reactor_(reactor), fns_(std::forward<Fs>(fns)...), remaining_(sizeof...(Fns)) {}
+
+        bool await_ready() const noexcept { return sizeof...(Fns) == 0; }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            continuation_ = h;
+            submitAll(std::index_sequence_for<Fns...>{});
+        }
+
+        Result await_resume() { return collect(std::index_sequence_for<Fns...>{}); }
+
+    private:
+        template<size_t... I>
+            void submitAll(std::index_sequence<I...>)
+            {
+                (submit<I>(), ...);
+            }
+
+        template<size_t I>
+            void submit()
+            {
+                Task task;
+                task.fn = [this]() {
+                    run<I>();
+                    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        reactor_.resumeOnReactor(continuation_);
+                    }
+                };
+                reactor_.postToWorkers(std::move(task));
+            }
+
+        template<size_t I>
+            void run()
+            {
+                auto& result = std::get<I>(results_);
+                try {
+                    if constexpr (std::is_void_v<BranchResult<std::tuple_element_t<I, std::tuple<Fns...>>>>) {
+                        std::get<I>(fns_)();
+                        result.setValue(std::monostate{});
+                    } else {
+                        result.setValue(std::get<I>(fns_)());
+                    }
+                } catch (...) {
+                    result.setError(std::current_exception());
+                }
+            }
+
+        template<size_t... I>
+            Result collect(std::index_sequence<I...>)
+            {
+                // Surface the first failure before moving anything out
+                (rethrowIfFailed(std::get<I>(results_)), ...);
+                return Result(std::get<I>(results_).get()...);
+            }
+
+        template<typename R>
+            static void rethrowIfFailed(R& result)
+            {
+                if (result.hasError()) {
+                    std::rethrow_exception(result.error());
+                }
+            }
+
+        Reactor& reactor_;
+        std::tuple<Fns...> fns_;
+        std::tuple<TaskResult<BranchValue<Fns>>...> results_;
+        std::atomic<size_t> remaining_;
+        std::coroutine_handle<> continuation_;
+};
+
+template<typename... Fns>
+WhenAll<std::decay_t<Fns>...> whenAll(Reactor& reactor, Fns&&... fns)
+{
+    return WhenAll<std::decay_t<Fns>...>(reactor, std::forward<Fns>(fns)...);
+}
+
+#endif
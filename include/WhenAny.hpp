@@ -0,0 +1,165 @@
+#ifndef WHEN_ANY_H
+#define WHEN_ANY_H
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "CancellationToken.hpp"
+#include "Completion.hpp"
+#include "Reactor.hpp"
+#include "Task.hpp"
+#include "WhenAll.hpp"
+
+// Branches may take the losers' CancellationToken
+template<typename Fn>
+using AnyBranchResult = std::remove_cvref_t<typename std::conditional_t<
+      std::is_invocable_v<Fn&, const CancellationToken&>,
+      std::invoke_result<Fn&, const CancellationToken&>,
+      std::invoke_result<Fn&>>::type>;
+
+template<typename T>
+struct WhenAnyResult
+{
+    size_t index;
+    T value;
+};
+
+// Awaitable that runs every callable on a worker at once and resumes the
+// awaiting coroutine on the reactor thread as soon as the first one
+// finishes (or throws, which is rethrown). The others are cancelled:
+// queued ones are dropped by the pool, running ones may poll the
+// CancellationToken they get if they take a const CancellationToken&.
+//
+//     auto first = co_await whenAny(reactor, [] { return askA(); }, [] { return askB(); });
+//     // first.index, first.value
+//
+// Losers can outlive the awaiting coroutine, so unlike WhenAll the
+// branches share a heap-allocated state, reference counted by hand to
+// keep each worker task small enough for std::function's inline buffer.
+// All callables must return the same type.
+template<typename... Fns>
+class WhenAny
+{
+    public:
+        using Common = std::common_type_t<AnyBranchResult<Fns>...>;
+        using Value = std::conditional_t<std::is_void_v<Common>, std::monostate, Common>;
+        using Result = WhenAnyResult<Value>;
+
+        template<typename... Fs>
+            WhenAny(Reactor& reactor, Fs&&... fns)
+            : state_(new State(reactor, std::forward<Fs>(fns)...)) {}
+
+        WhenAny(const WhenAny&) = delete;
+        WhenAny& operator=(const WhenAny&) = delete;
+        ~WhenAny() { state_->release(); }
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            state_->continuation = h;
+            submitAll(std::index_sequence_for<Fns...>{});
+        }
+
+        Result await_resume()
+        {
+            return Result{state_->winner, state_->result.get()};
+        }
+
+    private:
+        struct State
+        {
+            template<typename... Fs>
+                State(Reactor& r, Fs&&... f)
+                : reactor(r), fns(std::forward<Fs>(f)...) {}
+
+            Reactor& reactor;
+            std::tuple<Fns...> fns;
+            CancellationSource losers;
+            // One reference per branch plus the awaiter's
+            std::atomic<size_t> refs{sizeof...(Fns) + 1};
+            std::atomic<bool> decided{false};
+            size_t winner = 0;
+            TaskResult<Value> result;
+            std::coroutine_handle<> continuation;
+
+            void release()
+            {
+                if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    delete this;
+                }
+            }
+        };
+
+        template<size_t... I>
+            void submitAll(std::index_sequence<I...>)
+            {
+                (submit<I>(), ...);
+            }
+
+        template<size_t I>
+            void submit()
+            {
+                State* s = state_;
+                Task task;
+                task.fn = [s]() {
+                    run<I>(s);
+                    s->release();
+                };
+                task.onDrop = [s](DropReason) {
+                    s->release();
+                };
+                task.cancel = s->losers.token();
+                s->reactor.postToWorkers(std::move(task));
+            }
+
+        template<size_t I>
+            static void run(State* s)
+            {
+                auto& fn = std::get<I>(s->fns);
+                TaskResult<Value> result;
+                try {
+                    if constexpr (std::is_void_v<Common>) {
+                        invoke(fn, s);
+                        result.setValue(std::monostate{});
+                    } else {
+                        result.setValue(invoke(fn, s));
+                    }
+                } catch (...) {
+                    result.setError(std::current_exception());
+                }
+
+                if (s->losers.isCancelled() || s->decided.exchange(true, std::memory_order_acq_rel)) {
+                    return;
+                }
+                s->winner = I;
+                s->result = std::move(result);
+                s->losers.cancel();
+                s->reactor.resumeOnReactor(s->continuation);
+            }
+
+        template<typename Fn>
+            static decltype(auto) invoke(Fn& fn, State* s)
+            {
+                if constexpr (std::is_invocable_v<Fn&, const CancellationToken&>) {
+                    return fn(s->losers.token());
+                } else {
+                    return fn();
+                }
+            }
+
+        State* state_;
+};
+
+template<typename... Fns>
+WhenAny<std::decay_t<Fns>...> whenAny(Reactor& reactor, Fns&&... fns)
+{
+    static_assert(sizeof...(Fns) > 0, "whenAny needs at least one branch");
+    return WhenAny<std::decay_t<Fns>...>(reactor, std::forward<Fns>(fns)...);
+}
+
+#endif
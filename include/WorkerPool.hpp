@@ -1,21 +1,63 @@
 #ifndef WORKER_POOL_H
 #define WORKER_POOL_H
 
+#include <atomic>
+#include <cstdint>
 #include <thread>
+#include <vector>
+#include "ShardedCounter.hpp"
 #include "Task.hpp"
 #include "TaskQueue.hpp"
 
+// What an idle worker does before blocking on the queue: poll with a CPU
+// pause hint, then poll with sched_yield, then park until a push signals
+// it. Spinning trades CPU for wake-up latency; only worth it when workers
+// have cores of their own. The default parks right away.
+struct IdleStrategy
+{
+    unsigned spinIterations = 0;
+    unsigned yieldIterations = 0;
+};
+
+// Which idle tier a worker was in when it picked up a task
+enum class IdleTier
+{
+    Busy,
+    Spin,
+    Yield,
+    Park
+};
+
+struct WorkerPoolStats
+{
+    uint64_t executed;
+    uint64_t cancelled;
+    uint64_t deadlineMissed;
+    // Tasks picked up per idle tier, indexed by IdleTier
+    uint64_t pickedUp[4];
+    // Waiting in the queue right now
+    uint64_t queued;
+};
+
 class WorkerPool
 {
     public:
-        WorkerPool(size_t n);
+        WorkerPool(size_t n, IdleStrategy idle = IdleStrategy{});
         ~WorkerPool();
         void submit(Task t);
+        WorkerPoolStats stats() const;
     private:
         void loop();
+        Task next(IdleTier& tier);
         std::vector<std::thread> threads_;
         TaskQueue queue_;
+        IdleStrategy idle_;
         std::atomic<bool> stop_;
+        // Bumped by every worker for every task, so one line per thread
+        ShardedCounter executed_;
+        ShardedCounter cancelled_;
+        ShardedCounter deadlineMissed_;
+        ShardedCounter pickedUp_[4];
 };
 
 #endif
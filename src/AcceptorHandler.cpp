@@ -3,6 +3,7 @@
 #include <fcntl.h>
 #include "AcceptorHandler.hpp"
 #include "ConnectionHandler.hpp"
+#include "Probes.hpp"
 
 void AcceptorHandler::handleRead() {
     while (true) {
@@ -19,13 +20,19 @@ void AcceptorHandler::handleRead() {
         }
 
         std::cout << "[Acceptor] New client fd=" << client << std::endl;
+        REACTOR_PROBE2(accept, fd_, client);
 
         makeNonBlocking(client);
 
+        if (onAccept_) {
+            onAccept_(client);
+            continue;
+        }
+
         // TODO mejorar con using
         auto h = std::make_shared<ConnectionHandler>(client, reactor_);
 
-        reactor_->registerHandler(h);
+        reactor_->registerHandler(h, EPOLLIN | EPOLLOUT | EPOLLET);
     }
 };
 
@@ -1,27 +1,54 @@
 #include "ConnectionHandler.hpp"
+#include <cerrno>
+#include <cstdio>
 #include <iostream>
 #include <unistd.h>
+#include "Probes.hpp"
 
 void ConnectionHandler::handleRead() {
-    std::string message("");
     char buffer[4096];
 
-    while (true) {
+    while (outputBuffer_.size() - outputSent_ < maxOutput_) {
         ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+        REACTOR_PROBE2(recv, fd_, n);
 
         if (n > 0) {
-            std::string chunk(buffer, n);
-            auto pos = chunk.find("\n");
-            if (pos != std::string::npos) {
-                message.append(chunk);
-                scheduleTask(message);
-            } else {
-                message.append(chunk);
+            reactor_->metrics().bytesRead.add(n);
+            stats().bytesIn += n;
+            inputBuffer_.append(buffer, n);
+
+            // One task per complete line, in arrival order
+            size_t start = 0;
+            size_t pos;
+            while ((pos = inputBuffer_.find('\n', start)) != std::string::npos) {
+                if (discarding_) {
+                    // Tail of a line that was too long, already answered
+                    discarding_ = false;
+                } else {
+                    scheduleTask(inputBuffer_.substr(start, pos - start + 1));
+                }
+                start = pos + 1;
+            }
+            inputBuffer_.erase(0, start);
+
+            if (discarding_) {
+                inputBuffer_.clear();
+            } else if (inputBuffer_.size() > maxLine_) {
+                // Answered in its place; the rest of it is dropped
+                stats().messagesIn++;
+                deliver(nextSeq_++, "Error: line too long\n");
+                inputBuffer_.clear();
+                discarding_ = true;
+            }
+
+            // A failed reply send removes the handler
+            if (cancel_.isCancelled()) {
+                return;
             }
         } else if (n == 0) {
             std::cout << "[Conn] Closing " << fd_ << std::endl;
-            close(fd_);
-            break;
+            reactor_->removeHandler(fd_);
+            return;
         } else {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 // No more data, exit loop
@@ -36,21 +63,145 @@ void ConnectionHandler::handleRead() {
     }
 };
 
+void ConnectionHandler::handleWrite()
+{
+    bool paused = outputBuffer_.size() - outputSent_ >= maxOutput_;
+    flush();
+    if (paused && !cancel_.isCancelled() && outputBuffer_.size() - outputSent_ < maxOutput_) {
+        // Reading stopped on a full output buffer; the socket may still
+        // hold lines that no edge will announce again
+        handleRead();
+    }
+};
+
+void ConnectionHandler::handleClose()
+{
+    reactor_->metrics().connectionsClosed.add();
+    const ConnectionStats& s = stats();
+    REACTOR_PROBE4(conn__close, fd_, s.bytesIn, s.bytesOut, s.messagesIn);
+    reactor_->connectionStats().close(stats_);
+    cancel_.cancel();
+};
+
 void ConnectionHandler::scheduleTask(std::string message)
 {
+    if (cancel_.isCancelled()) {
+        return;
+    }
+
     // Capture shared_from_this() to keep the handler alive during async operation
     // This prevents use-after-free if the connection is closed before the task completes
     auto self = shared_from_this();
-    int fd = fd_; // Capture fd by value
+    uint64_t seq = nextSeq_++;
+    stats().messagesIn++;
+    stats().tasksInFlight++;
 
     reactor_->submitTask(
+            TaskOptions{
+                .cancel = cancel_.token(),
+                .deadline = TaskClock::now() + replyDeadline_,
+                // Prefixing a line is far cheaper than a worker round trip
+                .cheap = true,
+                .name = "echo"
+            },
             [message]() {
-            return "Async " + message;
+            auto start = TaskClock::now();
+            Reply reply{"Async " + message, 0};
+            reply.taskNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    TaskClock::now() - start).count();
+            return reply;
             },
-            [self, fd] (std::string response) {
-                // Verify the connection is still valid before sending
-                // The fd might be closed if the client disconnected
-                send(fd, response.c_str(), response.length(), 0);
+            [self, seq] (TaskResult<Reply> result) {
+                // Continuations run on the reactor thread, so the reorder
+                // buffer and the stats row need no locking
+                ConnectionStats& stats = self->stats();
+                stats.tasksInFlight--;
+                // Every sequence number gets a line, or later replies
+                // would wait in the reorder buffer for good
+                std::string text;
+                try {
+                    Reply reply = result.get();
+                    stats.taskNs += reply.taskNs;
+                    text = std::move(reply.text);
+                } catch (const DeadlineExceeded&) {
+                    text = "Error: deadline exceeded\n";
+                } catch (...) {
+                    text = "Error: task failed\n";
+                }
+                self->deliver(seq, std::move(text));
             }
             );
 };
+
+void ConnectionHandler::deliver(uint64_t seq, std::string response)
+{
+    if (seq != nextToSend_) {
+        reorderBuffer_.emplace(seq, std::move(response));
+        return;
+    }
+
+    send(response);
+    nextToSend_++;
+
+    // Release whatever was waiting on this reply
+    auto it = reorderBuffer_.begin();
+    while (it != reorderBuffer_.end() && it->first == nextToSend_) {
+        send(it->second);
+        nextToSend_++;
+        it = reorderBuffer_.erase(it);
+    }
+};
+
+void ConnectionHandler::send(const std::string& data)
+{
+    // A send error may already have removed the handler mid-batch
+    if (cancel_.isCancelled()) {
+        return;
+    }
+    stats().messagesOut++;
+
+    size_t sent = 0;
+    if (outputBuffer_.empty()) {
+        ssize_t n = ::send(fd_, data.c_str(), data.length(), MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("send");
+            reactor_->removeHandler(fd_);
+            return;
+        }
+        sent = n > 0 ? size_t(n) : 0;
+        reactor_->metrics().bytesWritten.add(sent);
+        stats().bytesOut += sent;
+    }
+
+    // Keep order behind whatever is already queued
+    if (sent < data.length()) {
+        outputBuffer_.append(data, sent);
+        stats().outputQueued = outputBuffer_.size() - outputSent_;
+    }
+};
+
+void ConnectionHandler::flush()
+{
+    while (outputSent_ < outputBuffer_.size()) {
+        ssize_t n = ::send(fd_, outputBuffer_.data() + outputSent_,
+                           outputBuffer_.size() - outputSent_, MSG_NOSIGNAL);
+        if (n > 0) {
+            outputSent_ += n;
+            reactor_->metrics().bytesWritten.add(n);
+            stats().bytesOut += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            perror("send");
+            reactor_->removeHandler(fd_);
+            return;
+        }
+    }
+
+    if (outputSent_ == outputBuffer_.size()) {
+        // Keeps its capacity for the next burst
+        outputBuffer_.clear();
+        outputSent_ = 0;
+    }
+    stats().outputQueued = outputBuffer_.size() - outputSent_;
+};
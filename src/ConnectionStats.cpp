@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/socket.h>
+#include "ConnectionStats.hpp"
+
+const char* connectionStatName(ConnectionStat stat)
+{
+    switch (stat) {
+        case ConnectionStat::BytesIn: return "bytes_in";
+        case ConnectionStat::BytesOut: return "bytes_out";
+        case ConnectionStat::Messages: return "messages";
+        case ConnectionStat::TasksInFlight: return "tasks_in_flight";
+        case ConnectionStat::TaskTime: return "task_time";
+        case ConnectionStat::OutputQueued: return "output_queued";
+    }
+    return "unknown";
+};
+
+static uint64_t statOf(const ConnectionStats& s, ConnectionStat stat)
+{
+    switch (stat) {
+        case ConnectionStat::BytesIn: return s.bytesIn;
+        case ConnectionStat::BytesOut: return s.bytesOut;
+        case ConnectionStat::Messages: return s.messagesIn + s.messagesOut;
+        case ConnectionStat::TasksInFlight: return s.tasksInFlight;
+        case ConnectionStat::TaskTime: return s.taskNs;
+        case ConnectionStat::OutputQueued: return s.outputQueued;
+    }
+    return 0;
+}
+
+ConnectionStatsTable::Slot ConnectionStatsTable::open(int fd)
+{
+    Slot slot;
+    if (!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+        rows_[slot] = ConnectionStats{};
+    } else {
+        slot = Slot(rows_.size());
+        rows_.emplace_back();
+    }
+
+    ConnectionStats& s = rows_[slot];
+    s.fd = fd;
+
+    sockaddr_in peer{};
+    socklen_t len = sizeof(peer);
+    if (getpeername(fd, (sockaddr*)&peer, &len) == 0 && peer.sin_family == AF_INET) {
+        s.peerAddr = peer.sin_addr.s_addr;
+        s.peerPort = ntohs(peer.sin_port);
+    }
+    return slot;
+};
+
+void ConnectionStatsTable::close(Slot slot)
+{
+    rows_[slot].fd = -1;
+    free_.push_back(slot);
+};
+
+std::vector<ConnectionStats> ConnectionStatsTable::topN(ConnectionStat stat, size_t n) const
+{
+    std::vector<ConnectionStats> open;
+    open.reserve(openCount());
+    for (const ConnectionStats& s : rows_) {
+        if (s.fd >= 0) {
+            open.push_back(s);
+        }
+    }
+
+    n = std::min(n, open.size());
+    std::partial_sort(open.begin(), open.begin() + n, open.end(),
+            [stat](const ConnectionStats& a, const ConnectionStats& b) {
+                return statOf(a, stat) > statOf(b, stat);
+            });
+    open.resize(n);
+    return open;
+};
+
+std::string ConnectionStatsTable::dump(size_t n) const
+{
+    std::ostringstream out;
+    out << "open connections: " << openCount() << "\n";
+
+    for (size_t i = 0; i < connectionStatCount; i++) {
+        ConnectionStat stat = ConnectionStat(i);
+        out << "\ntop " << n << " by " << connectionStatName(stat) << "\n"
+            << "fd\tpeer\tbytes_in\tbytes_out\tmsgs_in\tmsgs_out\tin_flight\ttask_us\tout_queued\n";
+        for (const ConnectionStats& s : topN(stat, n)) {
+            char addr[INET_ADDRSTRLEN] = "?";
+            in_addr a{s.peerAddr};
+            inet_ntop(AF_INET, &a, addr, sizeof(addr));
+            out << s.fd << "\t" << addr << ":" << s.peerPort
+                << "\t" << s.bytesIn << "\t" << s.bytesOut
+                << "\t" << s.messagesIn << "\t" << s.messagesOut
+                << "\t" << s.tasksInFlight << "\t" << s.taskNs / 1000
+                << "\t" << s.outputQueued << "\n";
+        }
+    }
+    return out.str();
+};
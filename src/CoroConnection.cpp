@@ -0,0 +1,163 @@
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+#include "CoroConnection.hpp"
+
+CoroConnection::CoroConnection(int fd, Reactor* reactor)
+    : fd_(fd), reactor_(reactor), stats_(reactor->connectionStats().open(fd))
+{
+    reactor_->watchIo(fd_);
+    reactor_->metrics().connectionsOpened.add();
+};
+
+CoroConnection::~CoroConnection()
+{
+    reactor_->unwatchIo(fd_);
+    close(fd_);
+    reactor_->metrics().connectionsClosed.add();
+    reactor_->connectionStats().close(stats_);
+};
+
+CoroTask<std::optional<std::string>> CoroConnection::readLine()
+{
+    while (true) {
+        size_t pos = inputBuffer_.find('\n', scanned_);
+        if (pos != std::string::npos) {
+            std::string line = inputBuffer_.substr(start_, pos - start_);
+            start_ = scanned_ = pos + 1;
+            stats().messagesIn++;
+            co_return line;
+        }
+        scanned_ = inputBuffer_.size();
+
+        switch (fill()) {
+            case Fill::Data:
+                break;
+            case Fill::WouldBlock:
+                co_await reactor_->readable(fd_);
+                break;
+            case Fill::Closed:
+                co_return std::nullopt;
+        }
+    }
+};
+
+AsyncGenerator<std::string_view> CoroConnection::lines()
+{
+    while (true) {
+        size_t pos = inputBuffer_.find('\n', scanned_);
+        if (pos != std::string::npos) {
+            std::string_view line(inputBuffer_.data() + start_, pos - start_);
+            start_ = scanned_ = pos + 1;
+            stats().messagesIn++;
+            // The buffer is only compacted by fill(), which cannot run
+            // before the consumer asks for the next line
+            co_yield line;
+            continue;
+        }
+        scanned_ = inputBuffer_.size();
+
+        switch (fill()) {
+            case Fill::Data:
+                break;
+            case Fill::WouldBlock:
+                co_await reactor_->readable(fd_);
+                break;
+            case Fill::Closed:
+                co_return;
+        }
+    }
+};
+
+CoroTask<std::optional<std::string_view>> CoroConnection::read(size_t n)
+{
+    while (true) {
+        if (inputBuffer_.size() - start_ >= n) {
+            std::string_view data(inputBuffer_.data() + start_, n);
+            start_ += n;
+            if (scanned_ < start_) {
+                scanned_ = start_;
+            }
+            co_return data;
+        }
+
+        switch (fill()) {
+            case Fill::Data:
+                break;
+            case Fill::WouldBlock:
+                co_await reactor_->readable(fd_);
+                break;
+            case Fill::Closed:
+                co_return std::nullopt;
+        }
+    }
+};
+
+CoroTask<bool> CoroConnection::write(std::string_view data)
+{
+    stats().messagesOut++;
+
+    while (!data.empty()) {
+        ssize_t n = send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+
+        if (n > 0) {
+            reactor_->metrics().bytesWritten.add(n);
+            stats().bytesOut += n;
+            data.remove_prefix(n);
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // What the caller still holds for us counts as queued output
+            stats().outputQueued = data.size();
+            co_await reactor_->writable(fd_);
+            stats().outputQueued = 0;
+        } else if (errno != EINTR) {
+            co_return false;
+        }
+    }
+    co_return true;
+};
+
+CoroConnection::Fill CoroConnection::fill()
+{
+    // Drop consumed lines before growing the buffer
+    if (start_ > 0) {
+        inputBuffer_.erase(0, start_);
+        scanned_ -= start_;
+        start_ = 0;
+    }
+
+    size_t used = inputBuffer_.size();
+    inputBuffer_.resize(used + 4096);
+    ssize_t n = recv(fd_, inputBuffer_.data() + used, 4096, 0);
+    inputBuffer_.resize(used + (n > 0 ? n : 0));
+
+    if (n > 0) {
+        reactor_->metrics().bytesRead.add(n);
+        stats().bytesIn += n;
+        return Fill::Data;
+    }
+    if (n == 0) {
+        return Fill::Closed;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return Fill::WouldBlock;
+    }
+    perror("recv");
+    return Fill::Closed;
+};
+
+CoroTask<void> coroEchoSession(Reactor* reactor, int fd)
+{
+    CoroConnection conn(fd, reactor);
+    auto lines = conn.lines();
+    // Reused for every reply, so steady state does not allocate
+    std::string response;
+
+    while (auto line = co_await lines.next()) {
+        response.assign("Async ");
+        response.append(*line);
+        response.push_back('\n');
+        if (!co_await conn.write(response)) {
+            break;
+        }
+    }
+};
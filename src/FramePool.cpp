@@ -0,0 +1,89 @@
+#include <new>
+#include "FramePool.hpp"
+
+namespace {
+
+struct alignas(std::max_align_t) FrameHeader
+{
+    FramePool* pool;
+    int sizeClass;
+};
+
+thread_local FramePool* currentPool = nullptr;
+
+}
+
+FramePool::~FramePool()
+{
+    for (size_t c = 0; c < classCount; c++) {
+        while (FreeBlock* b = freeLists_[c]) {
+            freeLists_[c] = b->next;
+            ::operator delete(b);
+        }
+    }
+};
+
+FramePool* FramePool::current()
+{
+    return currentPool;
+};
+
+void FramePool::setCurrent(FramePool* pool)
+{
+    currentPool = pool;
+};
+
+int FramePool::sizeClass(size_t size)
+{
+    size_t classSize = smallestClass;
+    for (size_t c = 0; c < classCount; c++, classSize <<= 1) {
+        if (size <= classSize) {
+            return c;
+        }
+    }
+    return -1;
+};
+
+void* FramePool::allocateFrame(size_t size)
+{
+    FramePool* pool = currentPool;
+    int c = pool ? sizeClass(size) : -1;
+
+    FrameHeader* h;
+    if (c < 0) {
+        h = static_cast<FrameHeader*>(::operator new(sizeof(FrameHeader) + size));
+        h->pool = nullptr;
+    } else {
+        pool->stats_.allocations++;
+        if (FreeBlock* b = pool->freeLists_[c]) {
+            pool->freeLists_[c] = b->next;
+            pool->cached_[c]--;
+            pool->stats_.reused++;
+            h = reinterpret_cast<FrameHeader*>(b);
+        } else {
+            h = static_cast<FrameHeader*>(
+                    ::operator new(sizeof(FrameHeader) + (smallestClass << c)));
+        }
+        h->pool = pool;
+    }
+
+    h->sizeClass = c;
+    return h + 1;
+};
+
+void FramePool::freeFrame(void* frame, size_t)
+{
+    FrameHeader* h = static_cast<FrameHeader*>(frame) - 1;
+    FramePool* pool = h->pool;
+    int c = h->sizeClass;
+
+    if (!pool || pool->cached_[c] >= maxCachedPerClass) {
+        ::operator delete(h);
+        return;
+    }
+
+    FreeBlock* b = reinterpret_cast<FreeBlock*>(h);
+    b->next = pool->freeLists_[c];
+    pool->freeLists_[c] = b;
+    pool->cached_[c]++;
+};
@@ -0,0 +1,394 @@
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <exception>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "HttpConnectionHandler.hpp"
+#include "Probes.hpp"
+
+// A request handed to a worker, with the bytes its views point into
+struct OwnedHttpRequest
+{
+    std::string raw;
+    HttpRequest request;
+};
+
+static const char* reasonPhrase(int status)
+{
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Content Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 505: return "HTTP Version Not Supported";
+    }
+    return "Unknown";
+}
+
+static void appendNumber(std::string& out, uint64_t n, int base = 10)
+{
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), n, base);
+    out.append(digits, result.ptr - digits);
+}
+
+// Handler exceptions become a 500 instead of escaping into the loop or
+// the worker
+static HttpResponse runHandler(const HttpHandler& handler, const HttpRequest& request)
+{
+    try {
+        return handler(request);
+    } catch (const std::exception& e) {
+        HttpResponse response;
+        response.status = 500;
+        response.body = std::string(e.what()) + "\n";
+        return response;
+    } catch (...) {
+        HttpResponse response;
+        response.status = 500;
+        response.body = "unknown error\n";
+        return response;
+    }
+}
+
+static uint64_t nsSince(TaskClock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(TaskClock::now() - start).count();
+}
+
+void HttpService::route(std::string path, HttpHandler handler)
+{
+    routes_[std::move(path)] = Route{std::move(handler), false, "http"};
+};
+
+void HttpService::routeToWorker(std::string path, HttpHandler handler, const char* name)
+{
+    routes_[std::move(path)] = Route{std::move(handler), true, name};
+};
+
+const HttpService::Route* HttpService::find(std::string_view path) const
+{
+    auto it = routes_.find(path);
+    return it == routes_.end() ? nullptr : &it->second;
+};
+
+void serializeHttpResponse(std::string& out, const HttpResponse& response,
+                           const HttpRequest& request)
+{
+    // HTTP/1.0 has no chunked coding
+    bool chunked = !response.chunks.empty() && request.minorVersion >= 1;
+
+    out += "HTTP/1.1 ";
+    appendNumber(out, response.status);
+    out += ' ';
+    out += reasonPhrase(response.status);
+    out += "\r\nContent-Type: ";
+    out += response.contentType;
+    if (chunked) {
+        out += "\r\nTransfer-Encoding: chunked";
+    } else {
+        size_t length = response.body.size();
+        if (!response.chunks.empty()) {
+            length = 0;
+            for (const std::string& chunk : response.chunks) {
+                length += chunk.size();
+            }
+        }
+        out += "\r\nContent-Length: ";
+        appendNumber(out, length);
+    }
+    if (!request.keepAlive) {
+        out += "\r\nConnection: close";
+    } else if (request.minorVersion == 0) {
+        out += "\r\nConnection: keep-alive";
+    }
+    out += "\r\n\r\n";
+
+    if (request.method == "HEAD") {
+        return;
+    }
+    if (chunked) {
+        for (const std::string& chunk : response.chunks) {
+            // An empty chunk would end the body early
+            if (chunk.empty()) {
+                continue;
+            }
+            appendNumber(out, chunk.size(), 16);
+            out += "\r\n";
+            out += chunk;
+            out += "\r\n";
+        }
+        out += "0\r\n\r\n";
+    } else if (!response.chunks.empty()) {
+        for (const std::string& chunk : response.chunks) {
+            out += chunk;
+        }
+    } else {
+        out += response.body;
+    }
+};
+
+void HttpConnectionHandler::handleRead()
+{
+    if (lingering_) {
+        // Everything was answered; wait for the client to hang up
+        char scratch[4096];
+        while (true) {
+            ssize_t n = recv(fd_, scratch, sizeof(scratch), 0);
+            if (n > 0) {
+                continue;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                reactor_->removeHandler(fd_);
+            }
+            return;
+        }
+    }
+
+    // A pass that stopped on a full output buffer goes again if the
+    // socket then took it all: no edge will announce input already waiting
+    bool full;
+    do {
+        // Requests left over from a full pipeline go first
+        parseRequests();
+        if (!readInput()) {
+            return;
+        }
+        full = outputFull();
+        flush();
+    } while (full && !lingering_ && !cancel_.isCancelled() && !outputFull());
+};
+
+void HttpConnectionHandler::handleWrite()
+{
+    bool full = outputFull();
+    flush();
+    if (full && !lingering_ && !cancel_.isCancelled() && !outputFull()) {
+        // Reading stopped on a full output buffer; the socket may still
+        // hold requests that no edge will announce again
+        handleRead();
+    }
+};
+
+void HttpConnectionHandler::handleClose()
+{
+    reactor_->metrics().connectionsClosed.add();
+    const ConnectionStats& s = stats();
+    REACTOR_PROBE4(conn__close, fd_, s.bytesIn, s.bytesOut, s.messagesIn);
+    reactor_->connectionStats().close(stats_);
+    cancel_.cancel();
+    if (lingerTimer_ >= 0) {
+        reactor_->cancelTimer(lingerTimer_);
+    }
+};
+
+bool HttpConnectionHandler::readInput()
+{
+    while (!closing_ && nextSeq_ - nextToSend_ < maxPipeline_ && !outputFull()) {
+        size_t used = inputBuffer_.size();
+        inputBuffer_.resize(used + readSize_);
+        ssize_t n = recv(fd_, inputBuffer_.data() + used, readSize_, 0);
+        inputBuffer_.resize(used + (n > 0 ? n : 0));
+        REACTOR_PROBE2(recv, fd_, n);
+
+        if (n > 0) {
+            reactor_->metrics().bytesRead.add(n);
+            stats().bytesIn += n;
+            parseRequests();
+        } else if (n == 0) {
+            reactor_->removeHandler(fd_);
+            return false;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            perror("recv");
+            reactor_->removeHandler(fd_);
+            return false;
+        }
+    }
+    return true;
+};
+
+void HttpConnectionHandler::parseRequests()
+{
+    size_t start = 0;
+    while (!closing_ && nextSeq_ - nextToSend_ < maxPipeline_ && !outputFull() &&
+           start < inputBuffer_.size()) {
+        auto status = parser_.parse(inputBuffer_.data() + start, inputBuffer_.size() - start, request_);
+        if (status == HttpParser::Status::Incomplete) {
+            break;
+        }
+
+        if (status == HttpParser::Status::Error) {
+            // Framing is lost, so nothing after this can be trusted
+            HttpRequest bad;
+            bad.keepAlive = false;
+            HttpResponse response;
+            response.status = parser_.errorStatus();
+            response.body = std::string(reasonPhrase(response.status)) + "\n";
+            std::string bytes;
+            serializeHttpResponse(bytes, response, bad);
+            closing_ = true;
+            deliver(nextSeq_++, std::move(bytes));
+            start = inputBuffer_.size();
+            break;
+        }
+
+        size_t length = parser_.consumed();
+        dispatch(inputBuffer_.data() + start, length);
+        start += length;
+        parser_.reset();
+    }
+    inputBuffer_.erase(0, start);
+};
+
+void HttpConnectionHandler::dispatch(const char* raw, size_t length)
+{
+    uint64_t seq = nextSeq_++;
+    stats().messagesIn++;
+    if (!request_.keepAlive) {
+        closing_ = true;
+    }
+
+    const HttpService::Route* route = service_->find(request_.path());
+    if (route == nullptr || !route->worker) {
+        HttpResponse response;
+        auto start = TaskClock::now();
+        if (route != nullptr) {
+            response = runHandler(route->handler, request_);
+            stats().taskNs += nsSince(start);
+        } else {
+            response.status = 404;
+            response.body = "Not Found\n";
+        }
+
+        if (seq == nextToSend_) {
+            // Nothing ahead of it: straight into the output buffer
+            serializeHttpResponse(outputBuffer_, response, request_);
+            stats().messagesOut++;
+            nextToSend_++;
+        } else {
+            std::string bytes;
+            serializeHttpResponse(bytes, response, request_);
+            deliver(seq, std::move(bytes));
+        }
+        return;
+    }
+
+    // The input buffer moves on before the worker runs
+    auto owned = std::make_shared<OwnedHttpRequest>();
+    owned->raw.assign(raw, length);
+    owned->request = request_;
+    owned->request.rebase(raw, owned->raw.data());
+
+    auto self = shared_from_this();
+    const HttpHandler* handler = &route->handler;
+    stats().tasksInFlight++;
+
+    reactor_->submitTask(
+            TaskOptions{
+                .cancel = cancel_.token(),
+                .name = route->name
+            },
+            [owned, handler]() {
+                auto start = TaskClock::now();
+                Reply reply;
+                serializeHttpResponse(reply.bytes, runHandler(*handler, owned->request), owned->request);
+                reply.taskNs = nsSince(start);
+                return reply;
+            },
+            [self, seq](Reply reply) {
+                ConnectionStats& stats = self->stats();
+                stats.tasksInFlight--;
+                stats.taskNs += reply.taskNs;
+
+                bool wasFull = self->nextSeq_ - self->nextToSend_ >= maxPipeline_ || self->outputFull();
+                self->deliver(seq, std::move(reply.bytes));
+                if (wasFull) {
+                    // Reading stopped at the limit; pick up where it left off
+                    self->handleRead();
+                } else {
+                    self->flush();
+                }
+            }
+            );
+};
+
+void HttpConnectionHandler::deliver(uint64_t seq, std::string bytes)
+{
+    if (seq != nextToSend_) {
+        reorderBuffer_.emplace(seq, std::move(bytes));
+        return;
+    }
+
+    outputBuffer_ += bytes;
+    stats().messagesOut++;
+    nextToSend_++;
+
+    // Release whatever was waiting on this response
+    auto it = reorderBuffer_.begin();
+    while (it != reorderBuffer_.end() && it->first == nextToSend_) {
+        outputBuffer_ += it->second;
+        stats().messagesOut++;
+        nextToSend_++;
+        it = reorderBuffer_.erase(it);
+    }
+};
+
+void HttpConnectionHandler::flush()
+{
+    if (cancel_.isCancelled()) {
+        return;
+    }
+
+    while (outputSent_ < outputBuffer_.size()) {
+        ssize_t n = ::send(fd_, outputBuffer_.data() + outputSent_,
+                           outputBuffer_.size() - outputSent_, MSG_NOSIGNAL);
+        if (n > 0) {
+            outputSent_ += n;
+            reactor_->metrics().bytesWritten.add(n);
+            stats().bytesOut += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            perror("send");
+            reactor_->removeHandler(fd_);
+            return;
+        }
+    }
+
+    if (outputSent_ == outputBuffer_.size()) {
+        // Keeps its capacity for the next batch
+        outputBuffer_.clear();
+        outputSent_ = 0;
+        if (closing_ && !lingering_ && nextToSend_ == nextSeq_) {
+            linger();
+            return;
+        }
+    }
+    stats().outputQueued = outputBuffer_.size() - outputSent_;
+};
+
+void HttpConnectionHandler::linger()
+{
+    lingering_ = true;
+    stats().outputQueued = 0;
+    shutdown(fd_, SHUT_WR);
+
+    std::weak_ptr<HttpConnectionHandler> weak = weak_from_this();
+    lingerTimer_ = reactor_->addTimer(lingerMs_, false, [weak]() {
+            auto self = weak.lock();
+            // A removed handler's fd may already belong to someone else
+            if (self && !self->cancel_.isCancelled()) {
+                self->lingerTimer_ = -1;
+                self->reactor_->removeHandler(self->fd_);
+            }
+            });
+    handleRead();
+};
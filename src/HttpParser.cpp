@@ -0,0 +1,276 @@
+#include <cstring>
+#include <strings.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "HttpParser.hpp"
+
+static bool isControl(char c)
+{
+    return (unsigned char)c < 0x20 || c == 0x7f;
+}
+
+// First CR, LF or other control byte in [p, end), or end
+static const char* findControl(const char* p, const char* end)
+{
+#ifdef __SSE2__
+    const __m128i limit = _mm_set1_epi8(0x1f);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // min(v, 0x1f) == v is an unsigned v <= 0x1f
+        __m128i ctl = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, limit), v),
+                                   _mm_cmpeq_epi8(v, del));
+        int mask = _mm_movemask_epi8(ctl);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && !isControl(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+bool httpHeaderHasToken(std::string_view value, std::string_view token)
+{
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        if (equalsIgnoreCase(trim(value.substr(0, comma)), token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+};
+
+std::string_view HttpRequest::path() const
+{
+    return target.substr(0, target.find('?'));
+};
+
+std::string_view HttpRequest::header(std::string_view name) const
+{
+    for (size_t i = 0; i < headerCount; i++) {
+        if (equalsIgnoreCase(headers[i].name, name)) {
+            return headers[i].value;
+        }
+    }
+    return {};
+};
+
+void HttpRequest::rebase(const char* from, const char* to)
+{
+    auto move = [from, to](std::string_view& v) {
+        if (v.data() != nullptr) {
+            v = std::string_view(to + (v.data() - from), v.size());
+        }
+    };
+    move(method);
+    move(target);
+    move(body);
+    for (size_t i = 0; i < headerCount; i++) {
+        move(headers[i].name);
+        move(headers[i].value);
+    }
+};
+
+HttpParser::Status HttpParser::parse(const char* data, size_t len, HttpRequest& req)
+{
+    // Stray CRLFs between requests are allowed (RFC 9112 2.2)
+    size_t skip = 0;
+    while (skip < len && (data[skip] == '\r' || data[skip] == '\n')) {
+        skip++;
+    }
+    const char* start = data + skip;
+    size_t available = len - skip;
+
+    if (headLength_ == 0) {
+        headLength_ = findHeadEnd(start, available);
+        if (headLength_ == 0) {
+            return available > maxHead ? fail(431) : Status::Incomplete;
+        }
+    }
+    if (headLength_ > maxHead) {
+        return fail(431);
+    }
+
+    Status status = parseHead(start, req);
+    if (status != Status::Complete) {
+        return status;
+    }
+
+    if (available - headLength_ < bodyLength_) {
+        return Status::Incomplete;
+    }
+    req.body = std::string_view(start + headLength_, bodyLength_);
+    consumed_ = skip + headLength_ + bodyLength_;
+    return Status::Complete;
+};
+
+void HttpParser::reset()
+{
+    scanned_ = 0;
+    headLength_ = 0;
+    bodyLength_ = 0;
+    consumed_ = 0;
+    errorStatus_ = 0;
+};
+
+size_t HttpParser::findHeadEnd(const char* data, size_t len)
+{
+    // A blank line ends the head: LF followed by CRLF or by LF
+    size_t pos = scanned_;
+    while (pos < len) {
+        const void* lf = memchr(data + pos, '\n', len - pos);
+        if (lf == nullptr) {
+            break;
+        }
+        size_t i = static_cast<const char*>(lf) - data;
+        if (i + 1 < len && data[i + 1] == '\n') {
+            return i + 2;
+        }
+        if (i + 2 < len && data[i + 1] == '\r' && data[i + 2] == '\n') {
+            return i + 3;
+        }
+        if (i + 2 >= len) {
+            // Not enough bytes after this LF to decide; look again later
+            scanned_ = i;
+            return 0;
+        }
+        pos = i + 1;
+    }
+    scanned_ = len;
+    return 0;
+};
+
+HttpParser::Status HttpParser::parseHead(const char* data, HttpRequest& req)
+{
+    const char* p = data;
+    const char* end = data + headLength_;
+
+    // Splits off the next line; false on a stray control byte
+    std::string_view line;
+    auto nextLine = [&]() {
+        const char* eol = findControl(p, end);
+        while (eol < end && *eol == '\t') {
+            eol = findControl(eol + 1, end);
+        }
+        if (eol == end) {
+            return false;
+        }
+        line = std::string_view(p, eol - p);
+        if (*eol == '\r' && eol + 1 < end && eol[1] == '\n') {
+            p = eol + 2;
+        } else if (*eol == '\n') {
+            p = eol + 1;
+        } else {
+            return false;
+        }
+        return true;
+    };
+
+    // Request line: METHOD SP target SP HTTP/1.x
+    if (!nextLine()) {
+        return fail(400);
+    }
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+    if (sp1 == 0 || sp2 == std::string_view::npos || sp2 == sp1 + 1) {
+        return fail(400);
+    }
+    req.method = line.substr(0, sp1);
+    req.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    std::string_view version = line.substr(sp2 + 1);
+    if (version.size() != 8 || version.compare(0, 7, "HTTP/1.") != 0) {
+        return fail(version.compare(0, 5, "HTTP/") == 0 ? 505 : 400);
+    }
+    if (version[7] != '0' && version[7] != '1') {
+        return fail(505);
+    }
+    req.minorVersion = version[7] - '0';
+    req.keepAlive = req.minorVersion == 1;
+    req.headerCount = 0;
+
+    bool haveLength = false;
+    size_t contentLength = 0;
+    while (nextLine() && !line.empty()) {
+        size_t colon = line.find(':');
+        // Obsolete line folding and whitespace before the colon are errors
+        if (colon == 0 || colon == std::string_view::npos ||
+            line[0] == ' ' || line[0] == '\t' ||
+            line[colon - 1] == ' ' || line[colon - 1] == '\t') {
+            return fail(400);
+        }
+        if (req.headerCount == HttpRequest::maxHeaders) {
+            return fail(431);
+        }
+
+        HttpHeader& h = req.headers[req.headerCount++];
+        h.name = line.substr(0, colon);
+        h.value = trim(line.substr(colon + 1));
+
+        if (equalsIgnoreCase(h.name, "content-length")) {
+            size_t n = 0;
+            if (h.value.empty() || h.value.size() > 9) {
+                return fail(h.value.empty() ? 400 : 413);
+            }
+            for (char c : h.value) {
+                if (c < '0' || c > '9') {
+                    return fail(400);
+                }
+                n = n * 10 + (c - '0');
+            }
+            if (haveLength && n != contentLength) {
+                return fail(400);
+            }
+            haveLength = true;
+            contentLength = n;
+        } else if (equalsIgnoreCase(h.name, "transfer-encoding")) {
+            return fail(501);
+        } else if (equalsIgnoreCase(h.name, "connection")) {
+            if (httpHeaderHasToken(h.value, "close")) {
+                req.keepAlive = false;
+            } else if (httpHeaderHasToken(h.value, "keep-alive")) {
+                req.keepAlive = true;
+            }
+        }
+    }
+    if (p != end || !line.empty()) {
+        return fail(400);
+    }
+    if (contentLength > maxBody) {
+        return fail(413);
+    }
+
+    bodyLength_ = contentLength;
+    req.body = {};
+    return Status::Complete;
+};
+
+HttpParser::Status HttpParser::fail(int status)
+{
+    errorStatus_ = status;
+    return Status::Error;
+};
@@ -0,0 +1,311 @@
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <strings.h>
+#include <sys/socket.h>
+#include "KvConnectionHandler.hpp"
+#include "Probes.hpp"
+
+static bool equalsIgnoreCase(std::string_view a, const char* b)
+{
+    size_t n = strlen(b);
+    return a.size() == n && strncasecmp(a.data(), b, n) == 0;
+}
+
+static bool parseInteger(std::string_view s, int64_t& n)
+{
+    auto parsed = std::from_chars(s.data(), s.data() + s.size(), n);
+    return parsed.ec == std::errc() && parsed.ptr == s.data() + s.size();
+}
+
+static void appendNumber(std::string& out, int64_t n)
+{
+    char digits[24];
+    auto written = std::to_chars(digits, digits + sizeof(digits), n);
+    out.append(digits, written.ptr - digits);
+}
+
+static void replyError(std::string& out, std::string_view message)
+{
+    out += "-ERR ";
+    out += message;
+    out += "\r\n";
+}
+
+static void replyInteger(std::string& out, int64_t n)
+{
+    out += ':';
+    appendNumber(out, n);
+    out += "\r\n";
+}
+
+static void replyBulk(std::string& out, std::string_view s)
+{
+    out += '$';
+    appendNumber(out, int64_t(s.size()));
+    out += "\r\n";
+    out += s;
+    out += "\r\n";
+}
+
+// Client bytes inside a simple-string reply: a CR or LF would end the
+// reply early and let the rest pass for more replies. Control bytes
+// become '?', and long names are cut at 128 bytes as Redis does.
+static void appendEchoed(std::string& out, std::string_view s)
+{
+    for (char c : s.substr(0, 128)) {
+        out += (unsigned char)c < 0x20 || c == 0x7f ? '?' : c;
+    }
+}
+
+static void replyArity(std::string& out, std::string_view command)
+{
+    out += "-ERR wrong number of arguments for '";
+    appendEchoed(out, command);
+    out += "' command\r\n";
+}
+
+void KvConnectionHandler::handleRead()
+{
+    if (lingering_) {
+        // Everything was answered; wait for the client to hang up
+        char scratch[4096];
+        while (true) {
+            ssize_t n = recv(fd_, scratch, sizeof(scratch), 0);
+            if (n > 0) {
+                continue;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                reactor_->removeHandler(fd_);
+            }
+            return;
+        }
+    }
+
+    while (!closing_ && outputBuffer_.size() - outputSent_ < maxOutput_) {
+        size_t used = inputBuffer_.size();
+        inputBuffer_.resize(used + readSize_);
+        ssize_t n = recv(fd_, inputBuffer_.data() + used, readSize_, 0);
+        inputBuffer_.resize(used + (n > 0 ? n : 0));
+        REACTOR_PROBE2(recv, fd_, n);
+
+        if (n > 0) {
+            reactor_->metrics().bytesRead.add(n);
+            stats().bytesIn += n;
+            parseCommands();
+        } else if (n == 0) {
+            reactor_->removeHandler(fd_);
+            return;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            perror("recv");
+            reactor_->removeHandler(fd_);
+            return;
+        }
+    }
+    flush();
+};
+
+void KvConnectionHandler::handleWrite()
+{
+    bool paused = outputBuffer_.size() - outputSent_ >= maxOutput_;
+    if (flush() && paused) {
+        // Reading stopped on a full output buffer; the socket may still
+        // hold commands that no edge will announce again
+        handleRead();
+    }
+};
+
+void KvConnectionHandler::handleClose()
+{
+    reactor_->metrics().connectionsClosed.add();
+    const ConnectionStats& s = stats();
+    REACTOR_PROBE4(conn__close, fd_, s.bytesIn, s.bytesOut, s.messagesIn);
+    reactor_->connectionStats().close(stats_);
+    removed_ = true;
+    if (lingerTimer_ >= 0) {
+        reactor_->cancelTimer(lingerTimer_);
+    }
+};
+
+void KvConnectionHandler::parseCommands()
+{
+    size_t start = 0;
+    while (!closing_ && start < inputBuffer_.size()) {
+        auto status = parser_.parse(inputBuffer_.data() + start, inputBuffer_.size() - start, command_);
+        if (status == RespParser::Status::Incomplete) {
+            break;
+        }
+        if (status == RespParser::Status::Error) {
+            replyError(outputBuffer_, parser_.error());
+            closing_ = true;
+            start = inputBuffer_.size();
+            break;
+        }
+
+        start += parser_.consumed();
+        if (command_.argc > 0) {
+            stats().messagesIn++;
+            execute(command_);
+        }
+    }
+    inputBuffer_.erase(0, start);
+};
+
+void KvConnectionHandler::execute(const RespCommand& cmd)
+{
+    std::string& out = outputBuffer_;
+    std::string_view name = cmd.args[0];
+    KvStore& store = *store_;
+    stats().messagesOut++;
+
+    if (equalsIgnoreCase(name, "GET")) {
+        if (cmd.argc != 2) {
+            return replyArity(out, name);
+        }
+        std::string_view value;
+        if (store.get(cmd.args[1], value)) {
+            replyBulk(out, value);
+        } else {
+            out += "$-1\r\n";
+        }
+    } else if (equalsIgnoreCase(name, "SET")) {
+        // SET key value [EX seconds | PX milliseconds]
+        if (cmd.argc != 3 && cmd.argc != 5) {
+            return cmd.argc < 3 ? replyArity(out, name) : replyError(out, "syntax error");
+        }
+        int64_t ttlMs = 0;
+        if (cmd.argc == 5) {
+            bool ex = equalsIgnoreCase(cmd.args[3], "EX");
+            if (!ex && !equalsIgnoreCase(cmd.args[3], "PX")) {
+                return replyError(out, "syntax error");
+            }
+            int64_t n;
+            if (!parseInteger(cmd.args[4], n) || n <= 0 || n > (ex ? maxTtlMs_ / 1000 : maxTtlMs_)) {
+                return replyError(out, "invalid expire time in 'set' command");
+            }
+            ttlMs = ex ? n * 1000 : n;
+        }
+        store.set(cmd.args[1], cmd.args[2]);
+        if (ttlMs > 0) {
+            store.expire(cmd.args[1], uint64_t(ttlMs));
+        }
+        out += "+OK\r\n";
+    } else if (equalsIgnoreCase(name, "DEL")) {
+        if (cmd.argc < 2) {
+            return replyArity(out, name);
+        }
+        int64_t erased = 0;
+        for (size_t i = 1; i < cmd.argc; i++) {
+            erased += store.erase(cmd.args[i]);
+        }
+        replyInteger(out, erased);
+    } else if (equalsIgnoreCase(name, "INCR")) {
+        if (cmd.argc != 2) {
+            return replyArity(out, name);
+        }
+        int64_t result;
+        if (!store.incr(cmd.args[1], 1, result)) {
+            return replyError(out, "value is not an integer or out of range");
+        }
+        replyInteger(out, result);
+    } else if (equalsIgnoreCase(name, "EXPIRE")) {
+        if (cmd.argc != 3) {
+            return replyArity(out, name);
+        }
+        int64_t seconds;
+        if (!parseInteger(cmd.args[2], seconds) || seconds > maxTtlMs_ / 1000) {
+            return replyError(out, "value is not an integer or out of range");
+        }
+        // A TTL that is already over deletes the key, as in Redis
+        replyInteger(out, store.expire(cmd.args[1], seconds > 0 ? uint64_t(seconds) * 1000 : 0));
+    } else if (equalsIgnoreCase(name, "MGET")) {
+        if (cmd.argc < 2) {
+            return replyArity(out, name);
+        }
+        out += '*';
+        appendNumber(out, int64_t(cmd.argc - 1));
+        out += "\r\n";
+        for (size_t i = 1; i < cmd.argc; i++) {
+            std::string_view value;
+            if (store.get(cmd.args[i], value)) {
+                replyBulk(out, value);
+            } else {
+                out += "$-1\r\n";
+            }
+        }
+    } else if (equalsIgnoreCase(name, "PING")) {
+        if (cmd.argc > 2) {
+            return replyArity(out, name);
+        }
+        if (cmd.argc == 2) {
+            replyBulk(out, cmd.args[1]);
+        } else {
+            out += "+PONG\r\n";
+        }
+    } else if (equalsIgnoreCase(name, "QUIT")) {
+        out += "+OK\r\n";
+        closing_ = true;
+    } else if (equalsIgnoreCase(name, "COMMAND")) {
+        // redis-cli asks for command docs on connect; there are none
+        out += "*0\r\n";
+    } else {
+        out += "-ERR unknown command '";
+        appendEchoed(out, name);
+        out += "'\r\n";
+    }
+};
+
+bool KvConnectionHandler::flush()
+{
+    if (removed_ || lingering_) {
+        return false;
+    }
+
+    while (outputSent_ < outputBuffer_.size()) {
+        ssize_t n = ::send(fd_, outputBuffer_.data() + outputSent_,
+                           outputBuffer_.size() - outputSent_, MSG_NOSIGNAL);
+        if (n > 0) {
+            outputSent_ += n;
+            reactor_->metrics().bytesWritten.add(n);
+            stats().bytesOut += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            perror("send");
+            reactor_->removeHandler(fd_);
+            return false;
+        }
+    }
+
+    if (outputSent_ == outputBuffer_.size()) {
+        // Keeps its capacity for the next batch
+        outputBuffer_.clear();
+        outputSent_ = 0;
+        if (closing_) {
+            linger();
+            return false;
+        }
+    }
+    stats().outputQueued = outputBuffer_.size() - outputSent_;
+    return true;
+};
+
+void KvConnectionHandler::linger()
+{
+    lingering_ = true;
+    stats().outputQueued = 0;
+    shutdown(fd_, SHUT_WR);
+
+    std::weak_ptr<KvConnectionHandler> weak = weak_from_this();
+    lingerTimer_ = reactor_->addTimer(lingerMs_, false, [weak]() {
+            auto self = weak.lock();
+            // A removed handler's fd may already belong to someone else
+            if (self && !self->removed_) {
+                self->lingerTimer_ = -1;
+                self->reactor_->removeHandler(self->fd_);
+            }
+            });
+    handleRead();
+};
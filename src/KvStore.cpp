@@ -0,0 +1,217 @@
+#include <charconv>
+#include <functional>
+#include <string>
+#include "KvStore.hpp"
+#include "Reactor.hpp"
+
+void SmallString::assign(std::string_view s)
+{
+    if (s.size() <= inlineCapacity) {
+        release();
+        std::memcpy(buf_, s.data(), s.size());
+        tag_ = uint8_t(s.size());
+        return;
+    }
+
+    // Reuse the heap block when it is the same size, which is common for
+    // values overwritten in place
+    if (tag_ == onHeap) {
+        Heap h;
+        std::memcpy(&h, buf_, sizeof(h));
+        if (h.size == s.size()) {
+            std::memcpy(h.data, s.data(), s.size());
+            return;
+        }
+        release();
+    }
+
+    Heap h{new char[s.size()], s.size()};
+    std::memcpy(h.data, s.data(), s.size());
+    std::memcpy(buf_, &h, sizeof(h));
+    tag_ = onHeap;
+};
+
+void SmallString::release()
+{
+    if (tag_ == onHeap) {
+        Heap h;
+        std::memcpy(&h, buf_, sizeof(h));
+        delete[] h.data;
+    }
+    tag_ = 0;
+};
+
+KvStore::KvStore(Reactor* reactor)
+    : reactor_(reactor), entries_(16)
+{
+};
+
+KvStore::~KvStore()
+{
+    // Pending expiries point back at this store
+    for (Entry& e : entries_) {
+        cancelExpiry(e);
+    }
+};
+
+bool KvStore::get(std::string_view key, std::string_view& value) const
+{
+    const Entry* e = find(key, hashOf(key));
+    if (e == nullptr) {
+        return false;
+    }
+    value = e->value.view();
+    return true;
+};
+
+void KvStore::set(std::string_view key, std::string_view value)
+{
+    Entry& e = insert(key);
+    cancelExpiry(e);
+    e.value.assign(value);
+};
+
+bool KvStore::erase(std::string_view key)
+{
+    Entry* e = find(key, hashOf(key));
+    if (e == nullptr) {
+        return false;
+    }
+    cancelExpiry(*e);
+    eraseAt(size_t(e - entries_.data()));
+    return true;
+};
+
+bool KvStore::incr(std::string_view key, int64_t delta, int64_t& result)
+{
+    Entry& e = insert(key);
+    std::string_view current = e.value.view();
+
+    int64_t n = 0;
+    if (!current.empty()) {
+        auto parsed = std::from_chars(current.data(), current.data() + current.size(), n);
+        if (parsed.ec != std::errc() || parsed.ptr != current.data() + current.size()) {
+            return false;
+        }
+    }
+    if (__builtin_add_overflow(n, delta, &result)) {
+        return false;
+    }
+
+    char digits[24];
+    auto written = std::to_chars(digits, digits + sizeof(digits), result);
+    e.value.assign(std::string_view(digits, written.ptr - digits));
+    return true;
+};
+
+bool KvStore::expire(std::string_view key, uint64_t ms)
+{
+    Entry* e = find(key, hashOf(key));
+    if (e == nullptr) {
+        return false;
+    }
+    cancelExpiry(*e);
+    if (ms == 0) {
+        eraseAt(size_t(e - entries_.data()));
+        return true;
+    }
+
+    // Entries move when the table grows or shifts, so the timer finds its
+    // entry by key; any change that drops the expiry cancels the timer
+    e->timer = reactor_->addTimer(ms, false, [this, key = std::string(key)]() {
+            Entry* expired = find(key, hashOf(key));
+            if (expired != nullptr) {
+                expired->timer = -1;
+                eraseAt(size_t(expired - entries_.data()));
+            }
+            });
+    return true;
+};
+
+uint64_t KvStore::hashOf(std::string_view key)
+{
+    uint64_t h = std::hash<std::string_view>{}(key);
+    return h != 0 ? h : 1;
+};
+
+KvStore::Entry* KvStore::find(std::string_view key, uint64_t hash)
+{
+    return const_cast<Entry*>(static_cast<const KvStore*>(this)->find(key, hash));
+};
+
+const KvStore::Entry* KvStore::find(std::string_view key, uint64_t hash) const
+{
+    for (size_t i = hash & mask(); ; i = (i + 1) & mask()) {
+        const Entry& e = entries_[i];
+        if (e.hash == 0) {
+            return nullptr;
+        }
+        if (e.hash == hash && e.key.view() == key) {
+            return &e;
+        }
+    }
+};
+
+KvStore::Entry& KvStore::insert(std::string_view key)
+{
+    uint64_t hash = hashOf(key);
+    if (Entry* e = find(key, hash)) {
+        return *e;
+    }
+
+    if ((size_ + 1) * 4 > entries_.size() * 3) {
+        grow();
+    }
+
+    size_t i = hash & mask();
+    while (entries_[i].hash != 0) {
+        i = (i + 1) & mask();
+    }
+    Entry& e = entries_[i];
+    e.hash = hash;
+    e.key.assign(key);
+    size_++;
+    return e;
+};
+
+void KvStore::eraseAt(size_t slot)
+{
+    // Backward shift: pull later members of the probe chain into the
+    // hole until an empty slot or an entry already at its home slot
+    size_t hole = slot;
+    for (size_t j = (slot + 1) & mask(); entries_[j].hash != 0; j = (j + 1) & mask()) {
+        size_t home = entries_[j].hash & mask();
+        // Whether home lies cyclically in (hole, j]: then j must stay
+        bool stays = hole <= j ? (hole < home && home <= j) : (hole < home || home <= j);
+        if (!stays) {
+            entries_[hole] = std::move(entries_[j]);
+            hole = j;
+        }
+    }
+    entries_[hole] = Entry{};
+    size_--;
+};
+
+void KvStore::cancelExpiry(Entry& e)
+{
+    if (e.timer >= 0) {
+        reactor_->cancelTimer(e.timer);
+        e.timer = -1;
+    }
+};
+
+void KvStore::grow()
+{
+    std::vector<Entry> old(entries_.size() * 2);
+    old.swap(entries_);
+    for (Entry& e : old) {
+        if (e.hash == 0) {
+            continue;
+        }
+        size_t i = e.hash & mask();
+        while (entries_[i].hash != 0) {
+            i = (i + 1) & mask();
+        }
+        entries_[i] = std::move(e);
+    }
+};
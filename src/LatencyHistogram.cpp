@@ -0,0 +1,73 @@
+#include "LatencyHistogram.hpp"
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (size_t i = 0; i < bucketCount; i++) {
+        bump(counts_[i], other.bucketCountAt(i));
+    }
+    bump(total_, other.count());
+    bump(sum_, other.sum());
+    if (other.max() > max()) {
+        max_.store(other.max(), std::memory_order_relaxed);
+    }
+};
+
+void LatencyHistogram::reset()
+{
+    for (auto& c : counts_) {
+        c.store(0, std::memory_order_relaxed);
+    }
+    total_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+};
+
+double LatencyHistogram::mean() const
+{
+    uint64_t n = count();
+    return n ? double(sum()) / n : 0.0;
+};
+
+uint64_t LatencyHistogram::percentile(double q) const
+{
+    // Sum the buckets rather than trusting total_, which a concurrent
+    // writer may have bumped ahead of the bucket
+    uint64_t total = 0;
+    for (size_t i = 0; i < bucketCount; i++) {
+        total += bucketCountAt(i);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = uint64_t(q * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > total) {
+        rank = total;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucketCount; i++) {
+        seen += bucketCountAt(i);
+        if (seen >= rank) {
+            uint64_t bound = bucketUpperBound(i);
+            return bound < max() ? bound : max();
+        }
+    }
+    return max();
+};
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t i)
+{
+    const uint64_t linear = uint64_t(1) << subBucketBits;
+    if (i < linear) {
+        return i;
+    }
+    size_t k = i - linear;
+    int msb = subBucketBits + int(k / (linear / 2));
+    uint64_t top = linear / 2 + k % (linear / 2);
+    int shift = msb - (subBucketBits - 1);
+    return ((top + 1) << shift) - 1;
+};
@@ -0,0 +1,71 @@
+#include <chrono>
+#include <mutex>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#include "LoopProfiler.hpp"
+
+const char* loopPhaseName(LoopPhase phase)
+{
+    switch (phase) {
+        case LoopPhase::Wait: return "wait";
+        case LoopPhase::Dispatch: return "dispatch";
+        case LoopPhase::Completions: return "completions";
+        case LoopPhase::Timers: return "timers";
+    }
+    return "unknown";
+};
+
+static bool invariantTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return edx & (1u << 8);
+    }
+#endif
+    return false;
+}
+
+void PhaseClock::calibrate()
+{
+    static std::once_flag once;
+    std::call_once(once, [] {
+        if (!invariantTsc()) {
+            return;
+        }
+
+        // Count ticks against the raw monotonic clock for 20ms; good to a
+        // fraction of a percent, which the histogram cannot resolve anyway
+        useTsc_ = true;
+        timespec a, b;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &a);
+        uint64_t start = now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        clock_gettime(CLOCK_MONOTONIC_RAW, &b);
+        uint64_t ticks = now() - start;
+
+        uint64_t ns = uint64_t(b.tv_sec - a.tv_sec) * 1000000000 + uint64_t(b.tv_nsec - a.tv_nsec);
+        if (ticks == 0) {
+            useTsc_ = false;
+            return;
+        }
+        nsPerTickQ32_ = uint64_t(((unsigned __int128)ns << 32) / ticks);
+    });
+};
+
+void LoopProfiler::enable(bool on)
+{
+    if (on) {
+        PhaseClock::calibrate();
+    }
+    enabled_.store(on, std::memory_order_release);
+};
+
+void LoopProfiler::reset()
+{
+    for (auto& h : histograms_) {
+        h.reset();
+    }
+};
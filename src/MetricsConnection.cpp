@@ -0,0 +1,204 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <sys/socket.h>
+#include "MetricsConnection.hpp"
+#include "TraceRecorder.hpp"
+
+void MetricsConnection::handleRead()
+{
+    char buffer[1024];
+
+    while (true) {
+        ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+
+        if (n > 0) {
+            if (responding_) {
+                // One request per connection; the answer may still be
+                // in the making
+                continue;
+            }
+            request_.append(buffer, n);
+            if (request_.find("\r\n\r\n") != std::string::npos) {
+                responding_ = true;
+                respond();
+                return;
+            }
+            if (request_.size() > maxRequest_) {
+                reactor_->removeHandler(fd_);
+                return;
+            }
+        } else if (n == 0) {
+            reactor_->removeHandler(fd_);
+            return;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("recv");
+                reactor_->removeHandler(fd_);
+            }
+            return;
+        }
+    }
+};
+
+void MetricsConnection::respond()
+{
+    const std::string text = "text/plain; version=0.0.4";
+    if (request_.compare(0, 13, "GET /metrics ") == 0) {
+        reply("200 OK", text, renderMetrics(*reactor_));
+    } else if (request_.compare(0, 16, "GET /connections") == 0) {
+        // Top talkers: /connections or /connections?top=N
+        size_t top = 10;
+        if (request_.compare(16, 5, "?top=") == 0) {
+            top = std::strtoul(request_.c_str() + 21, nullptr, 10);
+        }
+        reply("200 OK", text, reactor_->connectionStats().dump(top));
+    } else if (request_.compare(0, 11, "GET /trace ") == 0) {
+        auto self = shared_from_this();
+        reactor_->submitTask(
+                TaskOptions{
+                    .cancel = cancel_.token(),
+                    .name = "trace_export"
+                },
+                []() {
+                    std::ostringstream trace;
+                    TraceRecorder::writeChromeTrace(trace);
+                    return trace.str();
+                },
+                [self](std::string body) {
+                    self->reply("200 OK", "application/json", body);
+                });
+    } else {
+        reply("404 Not Found", text, "try /metrics, /connections?top=N or /trace\n");
+    }
+};
+
+void MetricsConnection::reply(const std::string& status, const std::string& type, const std::string& body)
+{
+    response_ = "HTTP/1.1 " + status + "\r\n"
+        "Content-Type: " + type + "\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+    flush();
+};
+
+void MetricsConnection::handleWrite()
+{
+    if (!response_.empty()) {
+        flush();
+    }
+};
+
+void MetricsConnection::handleClose()
+{
+    cancel_.cancel();
+};
+
+void MetricsConnection::flush()
+{
+    while (sent_ < response_.size()) {
+        ssize_t n = send(fd_, response_.data() + sent_, response_.size() - sent_, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent_ += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        } else {
+            perror("send");
+            break;
+        }
+    }
+    reactor_->removeHandler(fd_);
+};
+
+static void counter(std::ostringstream& out, const char* name, const char* help, uint64_t value)
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " counter\n"
+        << name << " " << value << "\n";
+}
+
+static void gauge(std::ostringstream& out, const char* name, const char* help, uint64_t value)
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " gauge\n"
+        << name << " " << value << "\n";
+}
+
+// Cumulative buckets at decades from 1us to 1s
+static void histogram(std::ostringstream& out, const char* name, const std::string& labels,
+                      const LatencyHistogram& h)
+{
+    static const uint64_t bounds[] = {
+        1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+
+    uint64_t cumulative = 0;
+    size_t bucket = 0;
+    for (uint64_t bound : bounds) {
+        while (bucket < LatencyHistogram::bucketCount &&
+               LatencyHistogram::bucketUpperBound(bucket) <= bound) {
+            cumulative += h.bucketCountAt(bucket++);
+        }
+        out << name << "_bucket{" << labels << ",le=\"" << bound / 1e9 << "\"} " << cumulative << "\n";
+    }
+    while (bucket < LatencyHistogram::bucketCount) {
+        cumulative += h.bucketCountAt(bucket++);
+    }
+    out << name << "_bucket{" << labels << ",le=\"+Inf\"} " << cumulative << "\n"
+        << name << "_sum{" << labels << "} " << h.sum() / 1e9 << "\n"
+        << name << "_count{" << labels << "} " << cumulative << "\n";
+}
+
+std::string renderMetrics(Reactor& reactor)
+{
+    std::ostringstream out;
+    ReactorMetrics& m = reactor.metrics();
+    WorkerPoolStats workers = reactor.workerStats();
+
+    uint64_t opened = m.connectionsOpened.value();
+    uint64_t closed = m.connectionsClosed.value();
+    counter(out, "reactor_connections_opened_total", "Client connections accepted.", opened);
+    gauge(out, "reactor_connections_open", "Client connections currently open.",
+          opened > closed ? opened - closed : 0);
+    counter(out, "reactor_bytes_read_total", "Bytes received from clients.", m.bytesRead.value());
+    counter(out, "reactor_bytes_written_total", "Bytes sent to clients.", m.bytesWritten.value());
+    counter(out, "reactor_pubsub_published_total", "Messages published to PubSub topics.",
+            m.messagesPublished.value());
+    counter(out, "reactor_pubsub_delivered_total", "PubSub messages queued to subscribers.",
+            m.messagesDelivered.value());
+
+    counter(out, "reactor_tasks_submitted_total", "Tasks queued to the worker pool.", m.tasksSubmitted.value());
+    counter(out, "reactor_tasks_inline_total", "Cheap tasks run on the reactor thread.", m.tasksInline.value());
+    counter(out, "reactor_tasks_executed_total", "Tasks run by workers.", workers.executed);
+    out << "# HELP reactor_tasks_dropped_total Queued tasks skipped by workers.\n"
+        << "# TYPE reactor_tasks_dropped_total counter\n"
+        << "reactor_tasks_dropped_total{reason=\"cancelled\"} " << workers.cancelled << "\n"
+        << "reactor_tasks_dropped_total{reason=\"deadline\"} " << workers.deadlineMissed << "\n";
+    gauge(out, "reactor_task_queue_depth", "Tasks waiting for a worker.", workers.queued);
+    gauge(out, "reactor_timers", "Pending timers.", reactor.timerCount());
+    counter(out, "reactor_loop_stalls_total", "Stalls reported by the watchdog.", reactor.stallCount());
+
+    // Profiling costs clock reads on every loop iteration, so it is opt-in
+    // and its histograms are left out rather than exported empty
+    const LoopProfiler& profiler = reactor.loopProfiler();
+    if (profiler.enabled()) {
+        out << "# HELP reactor_loop_phase_seconds Time per event loop phase.\n"
+            << "# TYPE reactor_loop_phase_seconds histogram\n";
+        for (size_t p = 0; p < loopPhaseCount; p++) {
+            std::string labels = std::string("phase=\"") + loopPhaseName(LoopPhase(p)) + "\"";
+            histogram(out, "reactor_loop_phase_seconds", labels, profiler.histogram(LoopPhase(p)));
+        }
+    }
+
+    out << "# HELP reactor_task_leg_seconds Sampled submitTask round trips by task type and leg.\n"
+        << "# TYPE reactor_task_leg_seconds histogram\n";
+    for (const auto& [type, trace] : reactor.taskTracer().types()) {
+        for (size_t l = 0; l < taskLegCount; l++) {
+            std::string labels = "type=\"" + type + "\",leg=\"" + taskLegName(TaskLeg(l)) + "\"";
+            histogram(out, "reactor_task_leg_seconds", labels, trace->legs[l]);
+        }
+    }
+
+    return out.str();
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "OutputQueue.hpp"
+
+void OutputQueue::append(SharedBuffer buffer)
+{
+    if (buffer.empty()) {
+        return;
+    }
+    bytes_ += buffer.size();
+    segments_.push_back(std::move(buffer));
+};
+
+ssize_t OutputQueue::writeTo(int fd)
+{
+    ssize_t total = 0;
+    while (!empty()) {
+        iovec iov[maxIov];
+        int count = int(std::min<size_t>(segments(), maxIov));
+        for (int i = 0; i < count; i++) {
+            const SharedBuffer& segment = segments_[head_ + i];
+            size_t skip = i == 0 ? headSent_ : 0;
+            iov[i].iov_base = const_cast<char*>(segment.data() + skip);
+            iov[i].iov_len = segment.size() - skip;
+        }
+
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        consume(size_t(n));
+        total += n;
+    }
+    return total;
+};
+
+void OutputQueue::clear()
+{
+    segments_.clear();
+    head_ = 0;
+    headSent_ = 0;
+    bytes_ = 0;
+};
+
+void OutputQueue::consume(size_t n)
+{
+    bytes_ -= n;
+    while (n > 0) {
+        size_t left = segments_[head_].size() - headSent_;
+        if (n < left) {
+            headSent_ += n;
+            return;
+        }
+        n -= left;
+        // Drop the reference now; the buffer may be the last one
+        segments_[head_++] = SharedBuffer();
+        headSent_ = 0;
+    }
+
+    if (empty()) {
+        segments_.clear();
+        head_ = 0;
+    } else if (head_ >= 1024 && head_ * 2 >= segments_.size()) {
+        // A queue that never drains still reuses its front
+        segments_.erase(segments_.begin(), segments_.begin() + head_);
+        head_ = 0;
+    }
+};
@@ -0,0 +1,20 @@
+#include "Probes.hpp"
+
+#ifdef REACTOR_HAVE_PROBES
+
+// Zero until a tracer attaches; see REACTOR_PROBE_ENABLED
+#define REACTOR_DEFINE_PROBE_SEMAPHORE(name) \
+    volatile unsigned short reactor_##name##_semaphore \
+        __attribute__((section(".probes"))) = 0
+
+extern "C" {
+REACTOR_DEFINE_PROBE_SEMAPHORE(accept);
+REACTOR_DEFINE_PROBE_SEMAPHORE(recv);
+REACTOR_DEFINE_PROBE_SEMAPHORE(conn__close);
+REACTOR_DEFINE_PROBE_SEMAPHORE(handler__remove);
+REACTOR_DEFINE_PROBE_SEMAPHORE(task__submit);
+REACTOR_DEFINE_PROBE_SEMAPHORE(task__complete);
+REACTOR_DEFINE_PROBE_SEMAPHORE(timer__fire);
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include "PubSub.hpp"
+
+// Order does not matter in any of these vectors
+template<typename T>
+static bool eraseUnordered(std::vector<T>& v, const T& value)
+{
+    auto it = std::find(v.begin(), v.end(), value);
+    if (it == v.end()) {
+        return false;
+    }
+    *it = std::move(v.back());
+    v.pop_back();
+    return true;
+}
+
+bool PubSub::subscribe(std::string_view topic, Subscriber* s)
+{
+    auto it = topics_.find(topic);
+    if (it == topics_.end()) {
+        it = topics_.emplace(std::string(topic), std::vector<Subscriber*>()).first;
+    } else if (std::find(it->second.begin(), it->second.end(), s) != it->second.end()) {
+        return false;
+    }
+    it->second.push_back(s);
+    s->topics_.emplace_back(topic);
+    return true;
+};
+
+bool PubSub::unsubscribe(std::string_view topic, Subscriber* s)
+{
+    auto it = topics_.find(topic);
+    if (it == topics_.end() || !eraseUnordered(it->second, s)) {
+        return false;
+    }
+    eraseUnordered(s->topics_, it->first);
+    if (it->second.empty()) {
+        topics_.erase(it);
+    }
+    return true;
+};
+
+void PubSub::unsubscribeAll(Subscriber* s)
+{
+    for (const std::string& topic : s->topics_) {
+        auto it = topics_.find(topic);
+        if (it != topics_.end()) {
+            eraseUnordered(it->second, s);
+            if (it->second.empty()) {
+                topics_.erase(it);
+            }
+        }
+    }
+    s->topics_.clear();
+
+    if (s->flushPending_) {
+        eraseUnordered(pending_, s);
+        s->flushPending_ = false;
+    }
+};
+
+size_t PubSub::publish(std::string_view topic, const SharedBuffer& message)
+{
+    auto it = topics_.find(topic);
+    if (it == topics_.end()) {
+        return 0;
+    }
+
+    for (Subscriber* s : it->second) {
+        s->deliver(message);
+        if (!s->flushPending_) {
+            s->flushPending_ = true;
+            pending_.push_back(s);
+        }
+    }
+    return it->second.size();
+};
+
+size_t PubSub::subscribers(std::string_view topic) const
+{
+    auto it = topics_.find(topic);
+    return it == topics_.end() ? 0 : it->second.size();
+};
+
+void PubSub::flushPending()
+{
+    // A flush may close its subscriber, which unsubscribes it; with the
+    // batch swapped out that only touches pending_
+    flushing_.swap(pending_);
+    for (Subscriber* s : flushing_) {
+        s->flushPending_ = false;
+        s->flushDeliveries();
+    }
+    flushing_.clear();
+};
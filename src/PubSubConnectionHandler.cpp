@@ -0,0 +1,196 @@
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <sys/socket.h>
+#include "Probes.hpp"
+#include "PubSubConnectionHandler.hpp"
+
+// Splits off the first space-separated word of s
+static std::string_view nextWord(std::string_view& s)
+{
+    size_t space = s.find(' ');
+    std::string_view word = s.substr(0, space);
+    s = space == std::string_view::npos ? std::string_view() : s.substr(space + 1);
+    return word;
+}
+
+void PubSubConnectionHandler::handleRead()
+{
+    readPaused_ = false;
+    while (!closing_) {
+        if (output_.bytes() >= maxQueued_) {
+            readPaused_ = true;
+            break;
+        }
+
+        size_t used = inputBuffer_.size();
+        inputBuffer_.resize(used + readSize_);
+        ssize_t n = recv(fd_, inputBuffer_.data() + used, readSize_, 0);
+        inputBuffer_.resize(used + (n > 0 ? n : 0));
+        REACTOR_PROBE2(recv, fd_, n);
+
+        if (n > 0) {
+            reactor_->metrics().bytesRead.add(n);
+            stats().bytesIn += n;
+
+            size_t start = 0;
+            size_t pos;
+            while (!closing_ && (pos = inputBuffer_.find('\n', start)) != std::string::npos) {
+                std::string_view line(inputBuffer_.data() + start, pos - start);
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+                execute(line);
+                start = pos + 1;
+            }
+            inputBuffer_.erase(0, start);
+            if (!closing_ && inputBuffer_.size() > maxLine_) {
+                reply("error", "line too long");
+                closing_ = true;
+            }
+        } else if (n == 0) {
+            reactor_->removeHandler(fd_);
+            return;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            perror("recv");
+            reactor_->removeHandler(fd_);
+            return;
+        }
+    }
+    flush();
+};
+
+void PubSubConnectionHandler::handleWrite()
+{
+    if (flush()) {
+        resumeReading();
+    }
+};
+
+void PubSubConnectionHandler::handleClose()
+{
+    reactor_->metrics().connectionsClosed.add();
+    const ConnectionStats& s = stats();
+    REACTOR_PROBE4(conn__close, fd_, s.bytesIn, s.bytesOut, s.messagesIn);
+    reactor_->connectionStats().close(stats_);
+    reactor_->pubsub().unsubscribeAll(this);
+    output_.clear();
+    removed_ = true;
+};
+
+void PubSubConnectionHandler::deliver(const SharedBuffer& message)
+{
+    if (overflowed_) {
+        return;
+    }
+    if (output_.bytes() + message.size() > maxQueued_) {
+        // Dropped by flushDeliveries, outside of publish
+        overflowed_ = true;
+        return;
+    }
+    output_.append(message);
+    stats().messagesOut++;
+};
+
+void PubSubConnectionHandler::flushDeliveries()
+{
+    // removeHandler drops the reactor's reference; this one lasts until
+    // we return
+    auto self = shared_from_this();
+    if (overflowed_) {
+        std::cout << "[PubSub] Dropping slow subscriber fd=" << fd_ << ", "
+                  << output_.bytes() << " bytes queued" << std::endl;
+        reactor_->removeHandler(fd_);
+        return;
+    }
+    if (flush()) {
+        resumeReading();
+    }
+};
+
+void PubSubConnectionHandler::resumeReading()
+{
+    if (readPaused_ && output_.bytes() < maxQueued_) {
+        // The socket may still hold commands that no edge will announce
+        // again
+        handleRead();
+    }
+};
+
+void PubSubConnectionHandler::execute(std::string_view line)
+{
+    stats().messagesIn++;
+    PubSub& pubsub = reactor_->pubsub();
+    std::string_view verb = nextWord(line);
+
+    if (verb == "PUB") {
+        std::string_view topic = nextWord(line);
+        if (topic.empty()) {
+            return reply("error", "usage: PUB topic text");
+        }
+        // Serialized once for every subscriber
+        std::string message;
+        message.reserve(topic.size() + line.size() + 3);
+        message += topic;
+        message += ": ";
+        message += line;
+        message += '\n';
+        size_t reached = pubsub.publish(topic, std::string_view(message));
+        reactor_->metrics().messagesPublished.add();
+        reactor_->metrics().messagesDelivered.add(reached);
+        reply("published", std::to_string(reached));
+    } else if (verb == "SUB" || verb == "UNSUB") {
+        std::string_view topic = nextWord(line);
+        if (topic.empty() || !line.empty()) {
+            return reply("error", verb == "SUB" ? "usage: SUB topic" : "usage: UNSUB topic");
+        }
+        if (verb == "SUB") {
+            pubsub.subscribe(topic, this);
+            reply("subscribed", topic);
+        } else {
+            pubsub.unsubscribe(topic, this);
+            reply("unsubscribed", topic);
+        }
+    } else if (!verb.empty()) {
+        reply("error", "unknown command");
+    }
+};
+
+void PubSubConnectionHandler::reply(std::string_view verb, std::string_view argument)
+{
+    std::string line;
+    line.reserve(verb.size() + argument.size() + 2);
+    line += verb;
+    line += ' ';
+    line += argument;
+    line += '\n';
+    output_.append(std::string_view(line));
+    stats().messagesOut++;
+};
+
+bool PubSubConnectionHandler::flush()
+{
+    if (removed_) {
+        return false;
+    }
+
+    ssize_t n = output_.writeTo(fd_);
+    if (n < 0) {
+        perror("sendmsg");
+        reactor_->removeHandler(fd_);
+        return false;
+    }
+    if (n > 0) {
+        reactor_->metrics().bytesWritten.add(n);
+        stats().bytesOut += n;
+    }
+
+    if (output_.empty() && closing_) {
+        reactor_->removeHandler(fd_);
+        return false;
+    }
+    stats().outputQueued = output_.bytes();
+    return true;
+};
@@ -1,11 +1,12 @@
 #include <algorithm>
+#include <climits>
 #include <iostream>
 #include <vector>
 #include <unistd.h>
 #include "Reactor.hpp"
 
-Reactor::Reactor()
-: workerPool_(2) {
+Reactor::Reactor(size_t workers, IdleStrategy idle)
+: workerPool_(workers, idle) {
     epollFd_ = epoll_create1(0);
     eventFd_ = eventfd(0, EFD_NONBLOCK);
     if (epollFd_ < 0) {
@@ -16,19 +17,19 @@ Reactor::Reactor()
     registerEpollEvent(eventFd_);
 };
 
-void Reactor::registerHandler(EventHandlerPtr handler) {
+void Reactor::registerHandler(EventHandlerPtr handler, uint32_t events) {
     int fd = handler->getHandle();
     handlers_[fd] = handler;
 
-    registerEpollEvent(fd);
+    registerEpollEvent(fd, events);
     std::cout << "[Reactor] Registered fd=" << fd << std::endl;
 };
 
-void Reactor::registerEpollEvent(int fd)
+void Reactor::registerEpollEvent(int fd, uint32_t events)
 {
     struct epoll_event ev {};
     ev.data.fd = fd;
-    ev.events = EPOLLIN | EPOLLET;
+    ev.events = events;
 
     if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
         perror("epoll_ctl ADD");
@@ -37,7 +38,15 @@ void Reactor::registerEpollEvent(int fd)
 };
 
 void Reactor::removeHandler(int fd) {
-    handlers_.erase(fd);
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end()) {
+        return;
+    }
+
+    EventHandlerPtr handler = it->second;
+    handlers_.erase(it);
+    REACTOR_PROBE2(handler__remove, fd, handlers_.size());
+    handler->handleClose();
 
     if (epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr) < 0) {
         perror("epoll_ctl DEL");
@@ -52,42 +61,249 @@ void Reactor::eventLoop() {
     const int MAX_EVENTS = 64;
     struct epoll_event events[MAX_EVENTS];
 
-    while (true) {
+    // Frames created while the loop runs come from this reactor's pool;
+    // whatever pool the thread had before is back once it returns, so one
+    // reactor never lends its pool to another's coroutines
+    struct PoolScope
+    {
+        FramePool* previous;
+        ~PoolScope() { FramePool::setCurrent(previous); }
+    } poolScope{FramePool::current()};
+    FramePool::setCurrent(&framePool_);
+    activity_.enterLoop();
+    TraceRecorder::setThreadName("reactor");
+    tracedSince_ = 0;
+
+    while (!stopped_) {
         int timeout = computeNextTimerTimeout();
 
+        enter(LoopActivity::Idle, 0);
+        uint64_t mark = profiler_.mark();
         int n = epoll_wait(epollFd_, events, MAX_EVENTS, timeout);
+        mark = profiler_.lap(LoopPhase::Wait, mark);
         if (n < 0) {
             perror("epoll_wait");
             continue;
         }
 
+        // Completions are drained after the batch's I/O so the two phases
+        // can be timed apart
+        bool completionsPosted = false;
+
         for (int i = 0; i < n; i++) {
             int fd = events[i].data.fd;
 
             if (fd == eventFd_) {
                 uint64_t val;
                 read(eventFd_, &val, sizeof(val));
-                processCompletedTasks();
+                completionsPosted = true;
+                continue;
             }
 
-            // fd might be removed
-            if (!handlers_.count(fd)) continue;
+            if (ioWaiters_.count(fd)) {
+                enter(LoopActivity::Io, fd);
+                resumeIo(fd, events[i].events);
+                continue;
+            }
+
+            // fd might be removed, also by the handler itself while it runs,
+            // so look it up again before every step and hold a reference
+            auto it = handlers_.find(fd);
+            if (it == handlers_.end()) continue;
+            EventHandlerPtr handler = it->second;
+            enter(LoopActivity::Handler, fd);
 
             if (events[i].events & (EPOLLIN)) {
-                handlers_[fd]->handleRead();
+                handler->handleRead();
             }
 
-            if (events[i].events & (EPOLLOUT)) {
-                handlers_[fd]->handleWrite();
+            if ((events[i].events & (EPOLLOUT)) && handlers_.count(fd)) {
+                handler->handleWrite();
             }
 
-            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+            if ((events[i].events & (EPOLLHUP | EPOLLERR)) && handlers_.count(fd)) {
                 std::cout << "[Reactor] HUP/ERR fd=" << fd << std::endl;
                 removeHandler(fd);
             }
         }
-        
+        mark = profiler_.lap(LoopPhase::Dispatch, mark);
+
+        if (completionsPosted) {
+            processCompletedTasks();
+            mark = profiler_.lap(LoopPhase::Completions, mark);
+        }
+
         processTimers();
+        profiler_.lap(LoopPhase::Timers, mark);
+
+        // Whatever this iteration published leaves in one write per
+        // subscriber
+        if (pubsub_.hasPending()) {
+            enter(LoopActivity::Handler, 0, "pubsub");
+            pubsub_.flushPending();
+        }
+    }
+
+    // Whatever ran last is not to blame for the time outside the loop
+    enter(LoopActivity::Idle, 0);
+    activity_.leaveLoop();
+
+    // Allow the loop to be entered again
+    stopped_ = false;
+};
+
+void Reactor::watchIo(int fd)
+{
+    if (ioWaiters_.count(fd)) {
+        return;
+    }
+
+    ioWaiters_[fd] = IoWaiter{};
+    // Both directions, edge-triggered: an fd costs one epoll_ctl for its
+    // whole life and IoWaiter remembers edges nobody was waiting for
+    registerEpollEvent(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+};
+
+void Reactor::unwatchIo(int fd)
+{
+    if (ioWaiters_.erase(fd) == 0) {
+        return;
+    }
+
+    if (epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr) < 0) {
+        perror("epoll_ctl DEL");
+    }
+};
+
+void Reactor::resumeIo(int fd, uint32_t events)
+{
+    const uint32_t failed = EPOLLHUP | EPOLLERR;
+
+    if (events & (EPOLLIN | EPOLLRDHUP | failed)) {
+        IoWaiter& w = ioWaiters_[fd];
+        if (w.reader) {
+            std::exchange(w.reader, {}).resume();
+        } else {
+            w.readReady = true;
+        }
+    }
+
+    // The reader may have unwatched the fd while it ran
+    auto it = ioWaiters_.find(fd);
+    if (it == ioWaiters_.end()) {
+        return;
+    }
+
+    if (events & (EPOLLOUT | failed)) {
+        IoWaiter& w = it->second;
+        if (w.writer) {
+            std::exchange(w.writer, {}).resume();
+        } else {
+            w.writeReady = true;
+        }
+    }
+};
+
+bool Reactor::IoAwaiter::await_ready()
+{
+    reactor_->watchIo(fd_);
+    IoWaiter& w = reactor_->ioWaiters_[fd_];
+    bool& ready = write_ ? w.writeReady : w.readReady;
+    return std::exchange(ready, false);
+};
+
+bool Reactor::IoAwaiter::suspend(std::coroutine_handle<> h, CancelScope* scope)
+{
+    if (scope && scope->requested()) {
+        cancelled_ = true;
+        return false;
+    }
+
+    IoWaiter& w = reactor_->ioWaiters_[fd_];
+    (write_ ? w.writer : w.reader) = h;
+    waiting_ = h;
+
+    if (scope) {
+        scope_ = scope;
+        scope->arm(&IoAwaiter::cancel, this);
+    }
+    return true;
+};
+
+void Reactor::IoAwaiter::cancel(void* self)
+{
+    auto* a = static_cast<IoAwaiter*>(self);
+    auto it = a->reactor_->ioWaiters_.find(a->fd_);
+    if (it != a->reactor_->ioWaiters_.end()) {
+        (a->write_ ? it->second.writer : it->second.reader) = nullptr;
+    }
+    a->cancelled_ = true;
+    a->waiting_.resume();
+};
+
+Reactor::IoAwaiter::~IoAwaiter()
+{
+    if (!waiting_) {
+        return;
+    }
+    auto it = reactor_->ioWaiters_.find(fd_);
+    if (it != reactor_->ioWaiters_.end()) {
+        auto& slot = write_ ? it->second.writer : it->second.reader;
+        if (slot == waiting_) {
+            slot = nullptr;
+        }
+    }
+};
+
+void Reactor::IoAwaiter::await_resume()
+{
+    if (scope_) {
+        scope_->disarm();
+    }
+    if (cancelled_) {
+        throw OperationCancelled();
+    }
+};
+
+bool Reactor::SleepAwaiter::suspend(std::coroutine_handle<> h, CancelScope* scope)
+{
+    if (scope && scope->requested()) {
+        cancelled_ = true;
+        return false;
+    }
+
+    timerId_ = reactor_->addTimer(ms_, h);
+    waiting_ = h;
+
+    if (scope) {
+        scope_ = scope;
+        scope->arm(&SleepAwaiter::cancel, this);
+    }
+    return true;
+};
+
+void Reactor::SleepAwaiter::cancel(void* self)
+{
+    auto* a = static_cast<SleepAwaiter*>(self);
+    a->reactor_->cancelTimer(a->timerId_);
+    a->cancelled_ = true;
+    a->waiting_.resume();
+};
+
+Reactor::SleepAwaiter::~SleepAwaiter()
+{
+    if (timerId_ >= 0) {
+        reactor_->cancelTimer(timerId_);
+    }
+};
+
+void Reactor::SleepAwaiter::await_resume()
+{
+    if (scope_) {
+        scope_->disarm();
+    }
+    if (cancelled_) {
+        throw OperationCancelled();
     }
 };
 
@@ -98,8 +314,38 @@ int Reactor::addTimer(uint64_t ms, bool recurring, std::function<void()> cb)
     t.expiresAt = nowMs() + ms;
     t.interval = recurring ? ms : 0;
     t.callback = std::move(cb);
-    timers_[t.expiresAt].push_back(t);
-    return t.id;
+    insertTimer(std::move(t));
+    return nextTimerId_ - 1;
+};
+
+int Reactor::addTimer(uint64_t ms, std::coroutine_handle<> waiter)
+{
+    Timer t;
+    t.id = nextTimerId_ ++;
+    t.expiresAt = nowMs() + ms;
+    t.interval = 0;
+    t.waiter = waiter;
+    insertTimer(std::move(t));
+    return nextTimerId_ - 1;
+};
+
+void Reactor::insertTimer(Timer t)
+{
+    int id = t.id;
+    uint64_t expiresAt = t.expiresAt;
+    timerIndex_[id] = timers_.emplace(expiresAt, std::move(t));
+};
+
+bool Reactor::cancelTimer(int id)
+{
+    auto live = timerIndex_.find(id);
+    if (live == timerIndex_.end()) {
+        return false;
+    }
+
+    timers_.erase(live->second);
+    timerIndex_.erase(live);
+    return true;
 };
 
 int Reactor::computeNextTimerTimeout()
@@ -109,7 +355,9 @@ int Reactor::computeNextTimerTimeout()
     if (!timers_.empty()) {
         uint64_t nextExpire = timers_.begin()->first;
         uint64_t now = nowMs();
-        timeout = nextExpire > now ? (nextExpire - now) : 0;
+        // epoll_wait takes an int; a far-off timer just means waking up
+        // once in a while to check again
+        timeout = nextExpire > now ? int(std::min<uint64_t>(nextExpire - now, INT_MAX)) : 0;
     }
 
     return timeout;
@@ -117,15 +365,176 @@ int Reactor::computeNextTimerTimeout()
 
 void Reactor::processCompletedTasks()
 {
-    std::queue<std::function<void()>> q;
     {
         std::lock_guard<std::mutex> lock(completedMtx_);
-        std::swap(q, completed_);
+        std::swap(draining_, completed_);
+        std::swap(resuming_, resumable_);
     }
 
-    while (!q.empty()) {
-        q.front()();
-        q.pop();
+    for (Completion* c : draining_) {
+        enter(LoopActivity::Completion, reinterpret_cast<uintptr_t>(c), c->name);
+        // No flow for a task submitted before tracing was turned on
+        if (c->flowId != 0 && TraceRecorder::enabled()) {
+            TraceRecorder::flow('f', c->name, c->flowId, TraceRecorder::now());
+        }
+        if (REACTOR_PROBE_ENABLED(task__complete)) {
+            probeComplete(*c);
+        }
+        if (!c->isCancelled()) {
+            // Dropped tasks never finished; only executed ones are traced
+            if (c->trace && c->trace->finished) {
+                tracer_.record(*c->trace, PhaseClock::now());
+            }
+            c->complete();
+        }
+        delete c;
+    }
+    draining_.clear();
+
+    for (std::coroutine_handle<> h : resuming_) {
+        enter(LoopActivity::Coroutine, reinterpret_cast<uintptr_t>(h.address()));
+        h.resume();
+    }
+    resuming_.clear();
+};
+
+void Reactor::runOnWorker(Completion* c)
+{
+    // TaskTracer and TraceRecorder are independent; both read PhaseClock,
+    // so a task sampled by both shares its two clock reads
+    bool recording = TraceRecorder::enabled();
+    if (!c->trace && !recording) {
+        c->execute();
+        postCompletion(c);
+        return;
+    }
+
+    uint64_t start = PhaseClock::now();
+    c->execute();
+    uint64_t end = PhaseClock::now();
+    if (c->trace) {
+        c->trace->dequeued = start;
+        c->trace->finished = end;
+    }
+    if (recording) {
+        TraceRecorder::slice("task", c->name, start, end, c->flowId);
+        if (c->flowId != 0) {
+            TraceRecorder::flow('t', c->name, c->flowId, start);
+        }
+    }
+    postCompletion(c);
+};
+
+void Reactor::enter(LoopActivity kind, uintptr_t id, const char* name)
+{
+    activity_.begin(kind, id, name);
+    if (!TraceRecorder::enabled()) {
+        tracedSince_ = 0;
+        return;
+    }
+
+    // Each activity's slice ends where the next one begins
+    uint64_t now = TraceRecorder::now();
+    if (tracedSince_ != 0) {
+        const char* slice = tracedKind_ == LoopActivity::Idle ? "epoll_wait"
+            : tracedName_ ? tracedName_ : loopActivityName(tracedKind_);
+        TraceRecorder::slice(loopActivityName(tracedKind_), slice, tracedSince_, now, tracedId_);
+    }
+    tracedKind_ = kind;
+    tracedId_ = id;
+    tracedName_ = name;
+    tracedSince_ = now;
+};
+
+void Reactor::postCompletion(Completion* c)
+{
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(completedMtx_);
+        wasEmpty = completed_.empty() && resumable_.empty();
+        if (c->trace) {
+            c->trace->enqueued = PhaseClock::now();
+        }
+        completed_.push_back(c);
+    }
+
+    // The reactor reads the eventfd before it swaps the queue, so only the
+    // first completion of a batch needs to wake it up
+    if (wasEmpty) {
+        wakeup();
+    }
+};
+
+void Reactor::resumeOnReactor(std::coroutine_handle<> h)
+{
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(completedMtx_);
+        wasEmpty = completed_.empty() && resumable_.empty();
+        resumable_.push_back(h);
+    }
+
+    if (wasEmpty) {
+        wakeup();
+    }
+};
+
+void Reactor::runInline(Completion& c, TaskClock::time_point deadline)
+{
+    // Same checks a worker would make before running it
+    if (c.isCancelled()) {
+        if (REACTOR_PROBE_ENABLED(task__complete)) {
+            probeComplete(c);
+        }
+        return;
+    }
+
+    // A sampled inline task has no queue or handoff; its trace only
+    // needs to live for this call
+    TaskTrace trace{c.name};
+    bool traced = tracer_.sample();
+    if (traced) {
+        trace.submitted = PhaseClock::now();
+        trace.dequeued = trace.submitted;
+    }
+
+    if (deadline != TaskClock::time_point::max() && deadline < TaskClock::now()) {
+        c.fail(std::make_exception_ptr(DeadlineExceeded()));
+        traced = false;
+    } else {
+        c.execute();
+    }
+
+    if (REACTOR_PROBE_ENABLED(task__complete)) {
+        probeComplete(c);
+    }
+    if (traced) {
+        trace.finished = PhaseClock::now();
+        trace.enqueued = trace.finished;
+        tracer_.record(trace, PhaseClock::now());
+    }
+    c.complete();
+};
+
+void Reactor::setStallWatchdog(std::chrono::milliseconds threshold)
+{
+    watchdog_.reset();
+    if (threshold.count() > 0) {
+        watchdog_ = std::make_unique<StallWatchdog>(activity_, threshold);
+    }
+};
+
+void Reactor::stop()
+{
+    stopped_ = true;
+    wakeup();
+};
+
+void Reactor::wakeup()
+{
+    uint64_t one = 1;
+    if (write(eventFd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        perror("write eventfd");
     }
 };
 
@@ -133,23 +542,27 @@ void Reactor::processTimers()
 {
     uint64_t now = nowMs();
 
-    while (!timers_.empty()) {
+    // One at a time: a callback may cancel or add timers due now
+    while (!timers_.empty() && timers_.begin()->first <= now) {
         auto it = timers_.begin();
+        Timer t = std::move(it->second);
+        timers_.erase(it);
 
-        if (it->first > now) {
-            break;
+        // Re-arm before firing so the callback can cancel it
+        if (t.interval > 0) {
+            Timer next = t;
+            next.expiresAt = now + t.interval;
+            insertTimer(std::move(next));
+        } else {
+            timerIndex_.erase(t.id);
         }
 
-        auto dueTimers = it->second;
-        timers_.erase(it);
-
-        for (auto& t : dueTimers) {
+        enter(LoopActivity::Timer, uintptr_t(t.id));
+        REACTOR_PROBE3(timer__fire, t.id, now - t.expiresAt, t.interval);
+        if (t.waiter) {
+            t.waiter.resume();
+        } else {
             t.callback();
-
-            if (t.interval > 0) {
-                t.expiresAt = now + t.interval;
-                timers_[t.expiresAt].push_back(t);
-            }
         }
     }
 };
@@ -161,3 +574,18 @@ uint64_t Reactor::nowMs()
             steady_clock::now().time_since_epoch()
             ).count();
 }
+
+uint64_t Reactor::probeNowNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(
+            steady_clock::now().time_since_epoch()
+            ).count();
+};
+
+void Reactor::probeComplete(Completion& c)
+{
+    // Zero when the tracer attached after the task was submitted
+    uint64_t latency = c.submittedNs != 0 ? probeNowNs() - c.submittedNs : 0;
+    REACTOR_PROBE4(task__complete, uintptr_t(&c), c.name, latency, int(c.isCancelled()));
+};
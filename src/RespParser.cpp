@@ -0,0 +1,115 @@
+#include <charconv>
+#include <cstring>
+#include "RespParser.hpp"
+
+// Reads "<n>\r\n" at p; false on anything else. p moves past the CRLF.
+static bool readLength(const char*& p, const char* end, long long& n, bool& complete)
+{
+    const char* lf = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (lf == nullptr) {
+        complete = false;
+        // A length line is a few digits; anything longer is garbage
+        return end - p < 32;
+    }
+    complete = true;
+    if (lf == p || lf[-1] != '\r') {
+        return false;
+    }
+    auto parsed = std::from_chars(p, lf - 1, n);
+    if (parsed.ec != std::errc() || parsed.ptr != lf - 1) {
+        return false;
+    }
+    p = lf + 1;
+    return true;
+}
+
+RespParser::Status RespParser::parse(const char* data, size_t len, RespCommand& cmd)
+{
+    if (len == 0) {
+        return Status::Incomplete;
+    }
+    if (data[0] != '*') {
+        return parseInline(data, len, cmd);
+    }
+
+    const char* p = data + 1;
+    const char* end = data + len;
+    long long count;
+    bool complete;
+    if (!readLength(p, end, count, complete)) {
+        return fail("Protocol error: invalid multibulk length");
+    }
+    if (!complete) {
+        return Status::Incomplete;
+    }
+    if (count < 0 || size_t(count) > RespCommand::maxArgs) {
+        return fail("Protocol error: invalid multibulk length");
+    }
+
+    cmd.argc = 0;
+    for (long long i = 0; i < count; i++) {
+        if (p == end) {
+            return Status::Incomplete;
+        }
+        if (*p != '$') {
+            return fail("Protocol error: expected '$'");
+        }
+        p++;
+        long long size;
+        if (!readLength(p, end, size, complete)) {
+            return fail("Protocol error: invalid bulk length");
+        }
+        if (!complete) {
+            return Status::Incomplete;
+        }
+        if (size < 0 || size_t(size) > maxBulk) {
+            return fail("Protocol error: invalid bulk length");
+        }
+        if (size_t(end - p) < size_t(size) + 2) {
+            return Status::Incomplete;
+        }
+        if (p[size] != '\r' || p[size + 1] != '\n') {
+            return fail("Protocol error: bulk string not terminated by CRLF");
+        }
+        cmd.args[cmd.argc++] = std::string_view(p, size);
+        p += size + 2;
+    }
+
+    consumed_ = p - data;
+    return Status::Complete;
+};
+
+RespParser::Status RespParser::parseInline(const char* data, size_t len, RespCommand& cmd)
+{
+    const char* lf = static_cast<const char*>(memchr(data, '\n', len));
+    if (lf == nullptr) {
+        return len > maxInline ? fail("Protocol error: too big inline request") : Status::Incomplete;
+    }
+
+    const char* end = lf > data && lf[-1] == '\r' ? lf - 1 : lf;
+    cmd.argc = 0;
+    for (const char* p = data; p < end; ) {
+        while (p < end && *p == ' ') {
+            p++;
+        }
+        const char* word = p;
+        while (p < end && *p != ' ') {
+            p++;
+        }
+        if (p > word) {
+            if (cmd.argc == RespCommand::maxArgs) {
+                return fail("Protocol error: too many arguments");
+            }
+            cmd.args[cmd.argc++] = std::string_view(word, p - word);
+        }
+    }
+
+    consumed_ = lf + 1 - data;
+    return Status::Complete;
+};
+
+RespParser::Status RespParser::fail(const char* error)
+{
+    error_ = error;
+    return Status::Error;
+};
@@ -0,0 +1,41 @@
+#include <cerrno>
+#include <cstdio>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include "SignalHandler.hpp"
+
+SignalHandler::SignalHandler(int signo, std::function<void()> onSignal)
+    : onSignal_(std::move(onSignal))
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, signo);
+    fd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd_ < 0) {
+        perror("signalfd");
+    }
+};
+
+void SignalHandler::handleRead()
+{
+    signalfd_siginfo info;
+    // Edge-triggered: drain every pending signal, run the callback once
+    bool fired = false;
+    while (read(fd_, &info, sizeof(info)) == sizeof(info)) {
+        fired = true;
+    }
+    if (errno != EAGAIN) {
+        perror("read signalfd");
+    }
+    if (fired) {
+        onSignal_();
+    }
+};
+
+void SignalHandler::blockSignal(int signo)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, signo);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+};
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <iostream>
+#include <string>
+#include "StallWatchdog.hpp"
+
+const char* loopActivityName(LoopActivity activity)
+{
+    switch (activity) {
+        case LoopActivity::Idle: return "idle";
+        case LoopActivity::Handler: return "handler";
+        case LoopActivity::Io: return "coroutine I/O";
+        case LoopActivity::Timer: return "timer";
+        case LoopActivity::Completion: return "completion";
+        case LoopActivity::Coroutine: return "coroutine";
+    }
+    return "unknown";
+};
+
+namespace {
+
+// Filled by the signal handler on the reactor thread. One sample at a
+// time for the whole process, guarded by captureMtx.
+constexpr int maxFrames = 64;
+void* frames[maxFrames];
+std::atomic<int> frameCount{-1};
+std::mutex captureMtx;
+
+void captureStack(int)
+{
+    // Not async-signal-safe by the letter; see StallWatchdog
+    frameCount.store(backtrace(frames, maxFrames), std::memory_order_release);
+}
+
+std::string demangle(const char* symbol)
+{
+    // "binary(mangled+0x12) [0xaddr]"
+    const char* open = std::strchr(symbol, '(');
+    const char* plus = open ? std::strchr(open, '+') : nullptr;
+    if (!open || !plus || plus == open + 1) {
+        return symbol;
+    }
+
+    std::string mangled(open + 1, plus);
+    int status = 0;
+    char* name = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    if (status != 0) {
+        return symbol;
+    }
+    std::string out = std::string(symbol, open + 1) + name + plus;
+    std::free(name);
+    return out;
+}
+
+}
+
+StallWatchdog::StallWatchdog(const LoopActivityState& activity, std::chrono::milliseconds threshold,
+                             int stackSignal)
+    : activity_(activity), threshold_(threshold), stackSignal_(stackSignal)
+{
+    void* warmup[1];
+    backtrace(warmup, 1);
+
+    struct sigaction sa {};
+    sa.sa_handler = captureStack;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(stackSignal_, &sa, &oldAction_);
+
+    thread_ = std::thread([this] { run(); });
+};
+
+StallWatchdog::~StallWatchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+
+    if (!sampleUnanswered_) {
+        sigaction(stackSignal_, &oldAction_, nullptr);
+    }
+};
+
+void StallWatchdog::run()
+{
+    using Clock = std::chrono::steady_clock;
+    // Detection lags a stall by at most a quarter of the threshold
+    auto poll = std::max(threshold_ / 4, std::chrono::milliseconds(1));
+
+    uint64_t lastSeq = activity_.seq.load(std::memory_order_acquire);
+    Clock::time_point since = Clock::now();
+    bool reported = false;
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!cv_.wait_for(lock, poll, [this] { return stop_; })) {
+        uint64_t seq = activity_.seq.load(std::memory_order_acquire);
+        auto now = Clock::now();
+
+        if (seq != lastSeq) {
+            if (reported) {
+                auto took = std::chrono::duration_cast<std::chrono::milliseconds>(now - since);
+                std::cerr << "[Watchdog] Event loop moved on after ~" << took.count() << " ms" << std::endl;
+            }
+            lastSeq = seq;
+            since = now;
+            reported = false;
+            continue;
+        }
+
+        if (reported || activity_.kind.load(std::memory_order_relaxed) == LoopActivity::Idle) {
+            continue;
+        }
+
+        auto stalledFor = std::chrono::duration_cast<std::chrono::milliseconds>(now - since);
+        if (stalledFor >= threshold_) {
+            reported = true;
+            stalls_.fetch_add(1, std::memory_order_relaxed);
+            report(stalledFor);
+        }
+    }
+};
+
+void StallWatchdog::report(std::chrono::milliseconds stalledFor)
+{
+    LoopActivity kind = activity_.kind.load(std::memory_order_relaxed);
+    uintptr_t id = activity_.id.load(std::memory_order_relaxed);
+    const char* name = activity_.name.load(std::memory_order_relaxed);
+
+    std::cerr << "[Watchdog] Event loop stalled for " << stalledFor.count()
+              << " ms in " << loopActivityName(kind);
+    switch (kind) {
+        case LoopActivity::Handler:
+        case LoopActivity::Io:
+            std::cerr << " fd=" << id;
+            break;
+        case LoopActivity::Timer:
+            std::cerr << " id=" << id;
+            break;
+        default:
+            std::cerr << " " << reinterpret_cast<void*>(id);
+            break;
+    }
+    if (name) {
+        std::cerr << " (" << name << ")";
+    }
+    std::cerr << std::endl;
+
+    dumpStack();
+};
+
+void StallWatchdog::dumpStack()
+{
+    std::lock_guard<std::mutex> lock(captureMtx);
+    frameCount.store(-1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> loop(activity_.threadMtx);
+        // The loop returned since the stall was seen
+        if (!activity_.looping || pthread_kill(activity_.thread, stackSignal_) != 0) {
+            return;
+        }
+    }
+
+    // A thread stuck in a system call takes the signal right away; give
+    // it up to 100ms anyway
+    int count = -1;
+    for (int i = 0; i < 100 && count < 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        count = frameCount.load(std::memory_order_acquire);
+    }
+    if (count < 0) {
+        sampleUnanswered_ = true;
+        std::cerr << "[Watchdog] No stack sample" << std::endl;
+        return;
+    }
+
+    char** symbols = backtrace_symbols(frames, count);
+    // Frame 0 is captureStack, frame 1 the signal trampoline
+    for (int i = 2; i < count; i++) {
+        std::cerr << "[Watchdog]   #" << i - 2 << " " << (symbols ? demangle(symbols[i]) : "?") << "\n";
+    }
+    std::cerr << std::flush;
+    std::free(symbols);
+};
@@ -1,17 +1,50 @@
+#include <algorithm>
 #include "TaskQueue.hpp"
 
 void TaskQueue::push(Task t)
 {
     std::lock_guard<std::mutex> lock(mtx_);
-    queue_.push(std::move(t));
+    t.seq = nextSeq_++;
+    heap_.push_back(std::move(t));
+    std::push_heap(heap_.begin(), heap_.end(), runsLater);
+    size_.store(heap_.size(), std::memory_order_release);
     cv_.notify_one();
 };
 
 Task TaskQueue::pop()
 {
     std::unique_lock<std::mutex> lock(mtx_);
-    cv_.wait(lock, [&] { return !queue_.empty(); });
-    Task t = queue_.front();
-    queue_.pop();
-    return std::move(t);
+    cv_.wait(lock, [&] { return !heap_.empty(); });
+    return takeTop();
+};
+
+bool TaskQueue::tryPop(Task& out)
+{
+    if (size_.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (heap_.empty()) {
+        return false;
+    }
+    out = takeTop();
+    return true;
+};
+
+Task TaskQueue::takeTop()
+{
+    std::pop_heap(heap_.begin(), heap_.end(), runsLater);
+    Task t = std::move(heap_.back());
+    heap_.pop_back();
+    size_.store(heap_.size(), std::memory_order_release);
+    return t;
+};
+
+bool TaskQueue::runsLater(const Task& a, const Task& b)
+{
+    if (a.deadline != b.deadline) {
+        return a.deadline > b.deadline;
+    }
+    return a.seq > b.seq;
 };
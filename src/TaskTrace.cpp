@@ -0,0 +1,40 @@
+#include "TaskTrace.hpp"
+
+const char* taskLegName(TaskLeg leg)
+{
+    switch (leg) {
+        case TaskLeg::Queue: return "queue";
+        case TaskLeg::Service: return "service";
+        case TaskLeg::Handoff: return "handoff";
+        case TaskLeg::Completion: return "completion";
+        case TaskLeg::Total: return "total";
+    }
+    return "unknown";
+};
+
+void TaskTracer::setSampleEvery(uint32_t n)
+{
+    if (n > 0) {
+        PhaseClock::calibrate();
+    }
+    sampleEvery_.store(n, std::memory_order_release);
+};
+
+void TaskTracer::record(const TaskTrace& trace, uint64_t now)
+{
+    auto it = types_.find(std::string_view(trace.name));
+    if (it == types_.end()) {
+        it = types_.emplace(trace.name, std::make_unique<TaskTypeTrace>()).first;
+    }
+    TaskTypeTrace* type = it->second.get();
+
+    // Ticks may come from different cores; never let skew go negative
+    auto leg = [&](TaskLeg l, uint64_t from, uint64_t to) {
+        type->legs[size_t(l)].record(PhaseClock::toNs(to > from ? to - from : 0));
+    };
+    leg(TaskLeg::Queue, trace.submitted, trace.dequeued);
+    leg(TaskLeg::Service, trace.dequeued, trace.finished);
+    leg(TaskLeg::Handoff, trace.finished, trace.enqueued);
+    leg(TaskLeg::Completion, trace.enqueued, now);
+    leg(TaskLeg::Total, trace.submitted, now);
+};
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+#include "TraceRecorder.hpp"
+
+namespace {
+
+struct ThreadRing
+{
+    explicit ThreadRing(size_t capacity) : events(capacity) {}
+
+    std::vector<TraceEvent> events;
+    // Events ever written; the ring holds the last events.size()
+    std::atomic<uint64_t> head{0};
+    pid_t tid = gettid();
+    std::atomic<const char*> name{nullptr};
+};
+
+// Rings outlive their threads so an export still shows exited workers
+std::mutex registryMtx;
+std::vector<std::unique_ptr<ThreadRing>> registry;
+
+thread_local ThreadRing* threadRing = nullptr;
+thread_local const char* threadName = nullptr;
+
+ThreadRing* ringForThread(size_t capacity)
+{
+    if (!threadRing) {
+        // Capacity is a power of two so the index is a mask
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        auto ring = std::make_unique<ThreadRing>(size);
+        ring->name.store(threadName, std::memory_order_relaxed);
+        threadRing = ring.get();
+
+        std::lock_guard<std::mutex> lock(registryMtx);
+        registry.push_back(std::move(ring));
+    }
+    return threadRing;
+}
+
+void writeEscaped(std::ostream& out, const char* s)
+{
+    out << '"';
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            out << '\\';
+        }
+        out << *s;
+    }
+    out << '"';
+}
+
+}
+
+void TraceRecorder::enable(size_t eventsPerThread)
+{
+    PhaseClock::calibrate();
+    capacity_.store(std::max<size_t>(eventsPerThread, 16), std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_release);
+};
+
+void TraceRecorder::disable()
+{
+    enabled_.store(false, std::memory_order_release);
+};
+
+void TraceRecorder::setThreadName(const char* name)
+{
+    threadName = name;
+    if (threadRing) {
+        threadRing->name.store(name, std::memory_order_relaxed);
+    }
+};
+
+void TraceRecorder::record(const TraceEvent& e)
+{
+    ThreadRing* ring = ringForThread(capacity_.load(std::memory_order_relaxed));
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->events[head & (ring->events.size() - 1)] = e;
+    ring->head.store(head + 1, std::memory_order_release);
+};
+
+void TraceRecorder::writeChromeTrace(std::ostream& out)
+{
+    // Rings are never freed, so only the list needs the lock; a thread
+    // starting to record waits at most for this copy
+    std::vector<const ThreadRing*> rings;
+    {
+        std::lock_guard<std::mutex> lock(registryMtx);
+        rings.reserve(registry.size());
+        for (const auto& ring : registry) {
+            rings.push_back(ring.get());
+        }
+    }
+    pid_t pid = getpid();
+
+    // Copy first, then keep only what the writers cannot have touched
+    struct Snapshot {
+        const ThreadRing* ring;
+        std::vector<TraceEvent> events;
+    };
+    std::vector<Snapshot> snapshots;
+    uint64_t base = UINT64_MAX;
+    for (const ThreadRing* ring : rings) {
+        size_t size = ring->events.size();
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t first = head > size ? head - size : 0;
+
+        std::vector<TraceEvent> copy;
+        copy.reserve(head - first);
+        for (uint64_t i = first; i < head; i++) {
+            copy.push_back(ring->events[i & (size - 1)]);
+        }
+
+        uint64_t after = ring->head.load(std::memory_order_acquire);
+        uint64_t overwritten = after > size ? after - size : 0;
+        if (overwritten > first) {
+            copy.erase(copy.begin(), copy.begin() + std::min<uint64_t>(overwritten - first, copy.size()));
+        }
+
+        for (const TraceEvent& e : copy) {
+            base = std::min(base, e.start);
+        }
+        snapshots.push_back({ring, std::move(copy)});
+    }
+
+    auto us = [base](uint64_t ticks) { return PhaseClock::toNs(ticks - base) / 1000.0; };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (const Snapshot& s : snapshots) {
+        const char* name = s.ring->name.load(std::memory_order_relaxed);
+        separator();
+        out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+            << ",\"tid\":" << s.ring->tid << ",\"args\":{\"name\":";
+        writeEscaped(out, name ? name : "thread");
+        out << "}}";
+
+        for (const TraceEvent& e : s.events) {
+            separator();
+            out << "{\"ph\":\"" << e.phase << "\",\"cat\":";
+            writeEscaped(out, e.category);
+            out << ",\"name\":";
+            writeEscaped(out, e.name);
+            out << ",\"pid\":" << pid << ",\"tid\":" << s.ring->tid
+                << ",\"ts\":" << us(e.start);
+            switch (e.phase) {
+                case 'X':
+                    out << ",\"dur\":" << PhaseClock::toNs(e.duration) / 1000.0
+                        << ",\"args\":{\"id\":" << e.arg << "}";
+                    break;
+                case 'i':
+                    out << ",\"s\":\"t\",\"args\":{\"id\":" << e.arg << "}";
+                    break;
+                case 'f':
+                    out << ",\"bp\":\"e\",\"id\":" << e.arg;
+                    break;
+                default:
+                    out << ",\"id\":" << e.arg;
+                    break;
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+};
+
+bool TraceRecorder::writeChromeTrace(const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    writeChromeTrace(out);
+    return bool(out);
+};
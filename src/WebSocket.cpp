@@ -0,0 +1,289 @@
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "WebSocket.hpp"
+
+static uint32_t rotl(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+std::array<uint8_t, 20> sha1(std::string_view data)
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    // Message, 0x80, zeros, then the bit length big-endian, in 64-byte blocks
+    uint64_t bits = uint64_t(data.size()) * 8;
+    size_t total = (data.size() + 8) / 64 * 64 + 64;
+    auto byteAt = [&](size_t i) -> uint8_t {
+        if (i < data.size()) {
+            return uint8_t(data[i]);
+        }
+        if (i == data.size()) {
+            return 0x80;
+        }
+        if (i >= total - 8) {
+            return uint8_t(bits >> (8 * (total - 1 - i)));
+        }
+        return 0;
+    };
+
+    for (size_t block = 0; block < total; block += 64) {
+        uint32_t w[80];
+        for (int t = 0; t < 16; t++) {
+            size_t i = block + t * 4;
+            w[t] = uint32_t(byteAt(i)) << 24 | uint32_t(byteAt(i + 1)) << 16 |
+                   uint32_t(byteAt(i + 2)) << 8 | uint32_t(byteAt(i + 3));
+        }
+        for (int t = 16; t < 80; t++) {
+            w[t] = rotl(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int t = 0; t < 80; t++) {
+            uint32_t f, k;
+            if (t < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (t < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (t < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[t];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::array<uint8_t, 20> digest;
+    for (int i = 0; i < 20; i++) {
+        digest[i] = uint8_t(h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+    return digest;
+};
+
+std::string base64Encode(const uint8_t* data, size_t len)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string out;
+    out.reserve((len + 2) / 3 * 4);
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < len) {
+            n |= uint32_t(data[i + 1]) << 8;
+        }
+        if (i + 2 < len) {
+            n |= data[i + 2];
+        }
+        out += alphabet[(n >> 18) & 63];
+        out += alphabet[(n >> 12) & 63];
+        out += i + 1 < len ? alphabet[(n >> 6) & 63] : '=';
+        out += i + 2 < len ? alphabet[n & 63] : '=';
+    }
+    return out;
+};
+
+std::string webSocketAccept(std::string_view key)
+{
+    std::string input(key);
+    input += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    auto digest = sha1(input);
+    return base64Encode(digest.data(), digest.size());
+};
+
+WsParse parseWsFrameHeader(const char* data, size_t len, WsFrameHeader& header)
+{
+    if (len < 2) {
+        return WsParse::Incomplete;
+    }
+    uint8_t b0 = uint8_t(data[0]);
+    uint8_t b1 = uint8_t(data[1]);
+
+    // No extension is negotiated, so the RSV bits must be clear
+    if (b0 & 0x70) {
+        return WsParse::Error;
+    }
+    header.fin = b0 & 0x80;
+    header.opcode = WsOpcode(b0 & 0x0f);
+    header.masked = b1 & 0x80;
+
+    bool control = b0 & 0x08;
+    switch (header.opcode) {
+        case WsOpcode::Continuation:
+        case WsOpcode::Text:
+        case WsOpcode::Binary:
+        case WsOpcode::Close:
+        case WsOpcode::Ping:
+        case WsOpcode::Pong:
+            break;
+        default:
+            return WsParse::Error;
+    }
+
+    size_t need = 2;
+    uint64_t length = b1 & 0x7f;
+    size_t extra = length == 126 ? 2 : length == 127 ? 8 : 0;
+    need += extra + (header.masked ? 4 : 0);
+    if (len < need) {
+        return WsParse::Incomplete;
+    }
+
+    if (extra > 0) {
+        length = 0;
+        for (size_t i = 0; i < extra; i++) {
+            length = length << 8 | uint8_t(data[2 + i]);
+        }
+        if (length >> 63) {
+            return WsParse::Error;
+        }
+    }
+    // Control frames are short and never fragmented
+    if (control && (!header.fin || length > 125)) {
+        return WsParse::Error;
+    }
+
+    header.payloadLength = length;
+    header.maskKey = 0;
+    if (header.masked) {
+        std::memcpy(&header.maskKey, data + 2 + extra, 4);
+    }
+    header.headerLength = need;
+    return WsParse::Complete;
+};
+
+void appendWsFrame(std::string& out, WsOpcode opcode, std::string_view payload)
+{
+    out += char(0x80 | uint8_t(opcode));
+    uint64_t len = payload.size();
+    if (len < 126) {
+        out += char(len);
+    } else if (len <= 0xffff) {
+        out += char(126);
+        out += char(len >> 8);
+        out += char(len);
+    } else {
+        out += char(127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out += char(len >> shift);
+        }
+    }
+    out += payload;
+};
+
+// Key for a payload position: byte i of the rotated key masks byte i of
+// data, which sits at offset + i in the payload. Assumes little endian,
+// like the x86 kernels.
+static uint32_t keyAt(uint32_t maskKey, uint64_t offset)
+{
+    int shift = int(offset & 3) * 8;
+    return shift == 0 ? maskKey : (maskKey >> shift) | (maskKey << (32 - shift));
+}
+
+// Whole 8-byte words, then single bytes. Every step is a multiple of 4
+// bytes, so the key keeps its phase throughout.
+static void unmaskScalar(char* data, size_t len, uint32_t key)
+{
+    uint64_t wide = uint64_t(key) << 32 | key;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        std::memcpy(&v, data + i, 8);
+        v ^= wide;
+        std::memcpy(data + i, &v, 8);
+    }
+    for (; i < len; i++) {
+        data[i] ^= char(key >> (8 * (i & 3)));
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static void unmaskSse2(char* data, size_t len, uint32_t key)
+{
+    __m128i k = _mm_set1_epi32(int(key));
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(v, k));
+    }
+    unmaskScalar(data + i, len - i, key);
+}
+
+__attribute__((target("avx2")))
+static void unmaskAvx2(char* data, size_t len, uint32_t key)
+{
+    __m256i k = _mm256_set1_epi32(int(key));
+    size_t i = 0;
+    // Two vectors per step keeps both load ports busy on large payloads
+    for (; i + 64 <= len; i += 64) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(a, k));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 32), _mm256_xor_si256(b, k));
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(a, k));
+    }
+    unmaskSse2(data + i, len - i, key);
+}
+#endif
+
+bool unmaskKernelSupported(UnmaskKernel kernel)
+{
+    switch (kernel) {
+        case UnmaskKernel::Scalar:
+            return true;
+#if defined(__x86_64__) || defined(__i386__)
+        case UnmaskKernel::Sse2:
+            return __builtin_cpu_supports("sse2");
+        case UnmaskKernel::Avx2:
+            return __builtin_cpu_supports("avx2");
+#else
+        default:
+            return false;
+#endif
+    }
+    return false;
+};
+
+void unmaskWs(char* data, size_t len, uint32_t maskKey, uint64_t offset, UnmaskKernel kernel)
+{
+    uint32_t key = keyAt(maskKey, offset);
+    switch (kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+        case UnmaskKernel::Avx2:
+            unmaskAvx2(data, len, key);
+            return;
+        case UnmaskKernel::Sse2:
+            unmaskSse2(data, len, key);
+            return;
+#endif
+        default:
+            unmaskScalar(data, len, key);
+            return;
+    }
+};
+
+void unmaskWs(char* data, size_t len, uint32_t maskKey, uint64_t offset)
+{
+    static const UnmaskKernel best = unmaskKernelSupported(UnmaskKernel::Avx2) ? UnmaskKernel::Avx2
+        : unmaskKernelSupported(UnmaskKernel::Sse2) ? UnmaskKernel::Sse2 : UnmaskKernel::Scalar;
+    unmaskWs(data, len, maskKey, offset, best);
+};
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <sys/socket.h>
+#include "Probes.hpp"
+#include "WebSocketConnectionHandler.hpp"
+
+static bool isControl(WsOpcode opcode)
+{
+    return uint8_t(opcode) & 0x08;
+}
+
+void WebSocketConnectionHandler::handleRead()
+{
+    if (state_ == State::Lingering) {
+        // The close frame is out; wait for the client to hang up
+        char scratch[4096];
+        while (true) {
+            ssize_t n = recv(fd_, scratch, sizeof(scratch), 0);
+            if (n > 0) {
+                continue;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                reactor_->removeHandler(fd_);
+            }
+            return;
+        }
+    }
+
+    reading_ = true;
+    while ((state_ == State::Handshake || state_ == State::Open) &&
+           outputBuffer_.size() - outputSent_ < maxOutput_) {
+        size_t used = inputBuffer_.size();
+        inputBuffer_.resize(used + readSize_);
+        ssize_t n = recv(fd_, inputBuffer_.data() + used, readSize_, 0);
+        inputBuffer_.resize(used + (n > 0 ? n : 0));
+        REACTOR_PROBE2(recv, fd_, n);
+
+        if (n > 0) {
+            reactor_->metrics().bytesRead.add(n);
+            stats().bytesIn += n;
+
+            size_t consumed = 0;
+            if (state_ == State::Handshake) {
+                consumed = handshake();
+            }
+            // Frames may follow the upgrade request in the same read
+            if (state_ == State::Open) {
+                consumed += parseFrames(inputBuffer_.data() + consumed, inputBuffer_.size() - consumed);
+            }
+            inputBuffer_.erase(0, consumed);
+        } else if (n == 0) {
+            reading_ = false;
+            reactor_->removeHandler(fd_);
+            return;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            perror("recv");
+            reading_ = false;
+            reactor_->removeHandler(fd_);
+            return;
+        }
+    }
+    reading_ = false;
+    flush();
+};
+
+void WebSocketConnectionHandler::handleWrite()
+{
+    bool paused = outputBuffer_.size() - outputSent_ >= maxOutput_;
+    if (flush() && paused) {
+        // Reading stopped on a full output buffer; the socket may still
+        // hold frames that no edge will announce again
+        handleRead();
+    }
+};
+
+void WebSocketConnectionHandler::handleClose()
+{
+    reactor_->metrics().connectionsClosed.add();
+    const ConnectionStats& s = stats();
+    REACTOR_PROBE4(conn__close, fd_, s.bytesIn, s.bytesOut, s.messagesIn);
+    reactor_->connectionStats().close(stats_);
+    removed_ = true;
+    if (lingerTimer_ >= 0) {
+        reactor_->cancelTimer(lingerTimer_);
+    }
+};
+
+void WebSocketConnectionHandler::send(std::string_view message, bool binary)
+{
+    if (state_ != State::Open) {
+        return;
+    }
+    appendWsFrame(outputBuffer_, binary ? WsOpcode::Binary : WsOpcode::Text, message);
+    stats().messagesOut++;
+    // Replies from inside handleRead go out with the rest of the batch
+    if (!reading_) {
+        flush();
+    }
+};
+
+void WebSocketConnectionHandler::close(uint16_t code)
+{
+    if (state_ != State::Open) {
+        return;
+    }
+    char payload[2] = {char(code >> 8), char(code)};
+    appendWsFrame(outputBuffer_, WsOpcode::Close, std::string_view(payload, 2));
+    state_ = State::Closing;
+    if (!reading_) {
+        flush();
+    }
+};
+
+size_t WebSocketConnectionHandler::handshake()
+{
+    auto status = parser_.parse(inputBuffer_.data(), inputBuffer_.size(), request_);
+    if (status == HttpParser::Status::Incomplete) {
+        return 0;
+    }
+
+    const HttpRequest& r = request_;
+    std::string_view key = r.header("Sec-WebSocket-Key");
+    if (status == HttpParser::Status::Error || r.method != "GET" || r.minorVersion != 1 ||
+        !httpHeaderHasToken(r.header("Upgrade"), "websocket") ||
+        !httpHeaderHasToken(r.header("Connection"), "upgrade") || key.size() != 24) {
+        outputBuffer_ += "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        state_ = State::Closing;
+        return inputBuffer_.size();
+    }
+    if (r.header("Sec-WebSocket-Version") != "13") {
+        outputBuffer_ += "HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\n"
+            "Content-Length: 0\r\nConnection: close\r\n\r\n";
+        state_ = State::Closing;
+        return inputBuffer_.size();
+    }
+
+    outputBuffer_ += "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+        "Connection: Upgrade\r\nSec-WebSocket-Accept: ";
+    outputBuffer_ += webSocketAccept(key);
+    outputBuffer_ += "\r\n\r\n";
+    state_ = State::Open;
+    return parser_.consumed();
+};
+
+size_t WebSocketConnectionHandler::parseFrames(char* data, size_t len)
+{
+    size_t pos = 0;
+    while (state_ == State::Open) {
+        if (!inFrame_) {
+            WsFrameHeader h;
+            WsParse status = parseWsFrameHeader(data + pos, len - pos, h);
+            if (status == WsParse::Incomplete) {
+                break;
+            }
+            // Clients must mask; data frames must continue only what is open
+            bool continuation = h.opcode == WsOpcode::Continuation;
+            bool start = h.opcode == WsOpcode::Text || h.opcode == WsOpcode::Binary;
+            if (status == WsParse::Error || !h.masked ||
+                (continuation && !messageOpen_) || (start && messageOpen_)) {
+                protocolError(1002);
+                break;
+            }
+            // message_ still holds the last delivered message until a new
+            // one starts; only a continuation adds to it
+            uint64_t buffered = continuation ? message_.size() : 0;
+            if ((start || continuation) && buffered + h.payloadLength > maxMessage) {
+                protocolError(1009);
+                break;
+            }
+            pos += h.headerLength;
+
+            // Common case: a whole message in one frame, already received.
+            // Unmask it where it lies and hand it over without copying.
+            if (start && h.fin && len - pos >= h.payloadLength) {
+                char* payload = data + pos;
+                size_t size = size_t(h.payloadLength);
+                unmaskWs(payload, size, h.maskKey, 0);
+                pos += size;
+                stats().messagesIn++;
+                deliver(std::string_view(payload, size), h.opcode == WsOpcode::Binary);
+                continue;
+            }
+
+            frame_ = h;
+            frameReceived_ = 0;
+            inFrame_ = true;
+            if (start) {
+                messageOpen_ = true;
+                messageBinary_ = h.opcode == WsOpcode::Binary;
+                message_.clear();
+            } else if (isControl(h.opcode)) {
+                control_.clear();
+            }
+        }
+
+        // Whatever part of the payload is here, unmasked at its offset
+        size_t n = size_t(std::min<uint64_t>(frame_.payloadLength - frameReceived_, len - pos));
+        unmaskWs(data + pos, n, frame_.maskKey, frameReceived_);
+        (isControl(frame_.opcode) ? control_ : message_).append(data + pos, n);
+        pos += n;
+        frameReceived_ += n;
+        if (frameReceived_ < frame_.payloadLength) {
+            break;
+        }
+        inFrame_ = false;
+        frameDone();
+    }
+    return pos;
+};
+
+void WebSocketConnectionHandler::frameDone()
+{
+    switch (frame_.opcode) {
+        case WsOpcode::Text:
+        case WsOpcode::Binary:
+        case WsOpcode::Continuation:
+            if (frame_.fin) {
+                messageOpen_ = false;
+                stats().messagesIn++;
+                deliver(message_, messageBinary_);
+            }
+            break;
+        case WsOpcode::Ping:
+            appendWsFrame(outputBuffer_, WsOpcode::Pong, control_);
+            break;
+        case WsOpcode::Pong:
+            break;
+        case WsOpcode::Close:
+            // Echo the status code, if any, and close
+            if (control_.size() == 1) {
+                protocolError(1002);
+            } else {
+                appendWsFrame(outputBuffer_, WsOpcode::Close, std::string_view(control_).substr(0, 2));
+                state_ = State::Closing;
+            }
+            break;
+    }
+};
+
+void WebSocketConnectionHandler::deliver(std::string_view message, bool binary)
+{
+    if (onMessage_) {
+        onMessage_(*this, message, binary);
+    }
+};
+
+void WebSocketConnectionHandler::protocolError(uint16_t code)
+{
+    close(code);
+};
+
+bool WebSocketConnectionHandler::flush()
+{
+    if (removed_) {
+        return false;
+    }
+
+    while (outputSent_ < outputBuffer_.size()) {
+        ssize_t n = ::send(fd_, outputBuffer_.data() + outputSent_,
+                           outputBuffer_.size() - outputSent_, MSG_NOSIGNAL);
+        if (n > 0) {
+            outputSent_ += n;
+            reactor_->metrics().bytesWritten.add(n);
+            stats().bytesOut += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            perror("send");
+            reactor_->removeHandler(fd_);
+            return false;
+        }
+    }
+
+    if (outputSent_ == outputBuffer_.size()) {
+        // Keeps its capacity for the next batch
+        outputBuffer_.clear();
+        outputSent_ = 0;
+        if (state_ == State::Closing) {
+            linger();
+            return false;
+        }
+    }
+    stats().outputQueued = outputBuffer_.size() - outputSent_;
+    return state_ != State::Lingering;
+};
+
+void WebSocketConnectionHandler::linger()
+{
+    state_ = State::Lingering;
+    stats().outputQueued = 0;
+    shutdown(fd_, SHUT_WR);
+
+    std::weak_ptr<WebSocketConnectionHandler> weak = weak_from_this();
+    lingerTimer_ = reactor_->addTimer(lingerMs_, false, [weak]() {
+            auto self = weak.lock();
+            // A removed handler's fd may already belong to someone else
+            if (self && !self->removed_) {
+                self->lingerTimer_ = -1;
+                self->reactor_->removeHandler(self->fd_);
+            }
+            });
+    handleRead();
+};
@@ -1,7 +1,23 @@
+#include "TraceRecorder.hpp"
 #include "WorkerPool.hpp"
 
-WorkerPool::WorkerPool(size_t n)
-    : stop_(false)
+namespace {
+
+// Tells the CPU we are busy-waiting: saves power and avoids the memory
+// order mis-speculation penalty when the spin ends
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+}
+
+WorkerPool::WorkerPool(size_t n, IdleStrategy idle)
+    : idle_(idle), stop_(false)
 {
     for (size_t i = 0; i < n; i++) {
         threads_.emplace_back([this] {
@@ -15,7 +31,9 @@ WorkerPool::~WorkerPool()
     stop_ = true;
     // wake up all workers
     for (size_t i = 0; i < threads_.size(); i++) {
-        queue_.push(Task{[]{}});
+        Task wake;
+        wake.fn = []{};
+        queue_.push(std::move(wake));
     }
     for (auto& t : threads_) {
         t.join();
@@ -29,8 +47,74 @@ void WorkerPool::submit(Task t)
 
 void WorkerPool::loop()
 {
+    TraceRecorder::setThreadName("worker");
+
     while (!stop_) {
-        Task t = queue_.pop();
+        IdleTier tier;
+        Task t = next(tier);
+        pickedUp_[static_cast<int>(tier)].add();
+
+        // Cancelled while queued: skip the work, let the owner clean up
+        if (t.cancel.isCancelled()) {
+            cancelled_.add();
+            if (t.onDrop) {
+                t.onDrop(DropReason::Cancelled);
+            }
+            continue;
+        }
+
+        // Nobody waits for a reply past its deadline
+        if (t.deadline != TaskClock::time_point::max() && t.deadline < TaskClock::now()) {
+            deadlineMissed_.add();
+            if (t.onDrop) {
+                t.onDrop(DropReason::DeadlineMissed);
+            }
+            continue;
+        }
+
         t.fn();
+        executed_.add();
+    }
+};
+
+Task WorkerPool::next(IdleTier& tier)
+{
+    Task t;
+
+    tier = IdleTier::Busy;
+    if (queue_.tryPop(t)) {
+        return t;
+    }
+
+    tier = IdleTier::Spin;
+    for (unsigned i = 0; i < idle_.spinIterations; i++) {
+        cpuRelax();
+        if (queue_.tryPop(t)) {
+            return t;
+        }
+    }
+
+    tier = IdleTier::Yield;
+    for (unsigned i = 0; i < idle_.yieldIterations; i++) {
+        std::this_thread::yield();
+        if (queue_.tryPop(t)) {
+            return t;
+        }
+    }
+
+    tier = IdleTier::Park;
+    return queue_.pop();
+};
+
+WorkerPoolStats WorkerPool::stats() const
+{
+    WorkerPoolStats s{};
+    s.executed = executed_.value();
+    s.cancelled = cancelled_.value();
+    s.deadlineMissed = deadlineMissed_.value();
+    for (int i = 0; i < 4; i++) {
+        s.pickedUp[i] = pickedUp_[i].value();
     }
+    s.queued = queue_.size();
+    return s;
 };
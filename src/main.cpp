@@ -2,47 +2,242 @@
 #include <sys/socket.h> 
 #include <netinet/in.h>
 #include <fcntl.h>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
 #include "AcceptorHandler.hpp"
+#include "CoroConnection.hpp"
 #include "EventHandler.hpp"
+#include "HttpConnectionHandler.hpp"
+#include "KvConnectionHandler.hpp"
+#include "MetricsConnection.hpp"
+#include "PubSubConnectionHandler.hpp"
 #include "Reactor.hpp"
+#include "SignalHandler.hpp"
+#include "TraceRecorder.hpp"
+#include "WebSocketConnectionHandler.hpp"
 
-int main() {
-    Reactor reactor;
-
-    int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
-    if (listenFd < 0) {
+static int listenOn(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
         perror("socket");
-        return 1;
+        return -1;
     }
 
     int opt = 1;
-    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(9000);
+    addr.sin_port = htons(port);
 
-    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
         perror("bind");
-        return 1;
+        close(fd);
+        return -1;
     }
 
-    if (listen(listenFd, 128) < 0) {
+    if (listen(fd, 128) < 0) {
         perror("listen");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Routes served with --http
+static std::shared_ptr<HttpService> demoHttpService()
+{
+    auto service = std::make_shared<HttpService>();
+    service->route("/", [](const HttpRequest&) {
+            HttpResponse response;
+            response.body = "Hello, World!\n";
+            return response;
+            });
+    service->route("/echo", [](const HttpRequest& request) {
+            HttpResponse response;
+            response.body = std::string(request.body);
+            return response;
+            });
+    service->route("/stream", [](const HttpRequest&) {
+            HttpResponse response;
+            for (int i = 1; i <= 5; i++) {
+                response.chunks.push_back("chunk " + std::to_string(i) + "\n");
+            }
+            return response;
+            });
+    // CPU-bound, so it runs on a worker: /work?n=ITERATIONS
+    service->routeToWorker("/work", [](const HttpRequest& request) {
+            std::string_view target = request.target;
+            size_t query = target.find("?n=");
+            uint64_t n = query == std::string_view::npos
+                ? 100000 : std::strtoull(target.data() + query + 3, nullptr, 10);
+            uint64_t x = 88172645463325252ull;
+            for (uint64_t i = 0; i < n; i++) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+            }
+            HttpResponse response;
+            response.body = std::to_string(x) + "\n";
+            return response;
+            }, "work");
+    return service;
+}
+
+int main(int argc, char** argv) {
+    // --coro serves clients with coroEchoSession instead of ConnectionHandler;
+    // --http serves HTTP/1.1 on the same port with HttpConnectionHandler;
+    // --kv serves a Redis-protocol key-value store there instead;
+    // --ws echoes WebSocket messages there instead;
+    // --pubsub serves SUB/UNSUB/PUB topics there instead;
+    // --profile prints per-phase event loop latencies with the stats and
+    // adds them to the metrics (a few clock reads per loop iteration);
+    // --metrics-port N moves the Prometheus endpoint (0 turns it off);
+    // --trace-tasks N traces one in N worker tasks into the metrics;
+    // --watchdog MS reports loop stalls longer than MS (0 turns it off);
+    // --trace-events records a timeline, dumped on SIGUSR1 or GET /trace
+    bool coro = false;
+    bool http = false;
+    bool kv = false;
+    bool ws = false;
+    bool pubsub = false;
+    bool traceEvents = false;
+    bool profile = false;
+    int metricsPort = 9100;
+    int traceEvery = 0;
+    int watchdogMs = 200;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--coro") == 0) {
+            coro = true;
+        } else if (std::strcmp(argv[i], "--http") == 0) {
+            http = true;
+        } else if (std::strcmp(argv[i], "--kv") == 0) {
+            kv = true;
+        } else if (std::strcmp(argv[i], "--ws") == 0) {
+            ws = true;
+        } else if (std::strcmp(argv[i], "--pubsub") == 0) {
+            pubsub = true;
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if (std::strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            metricsPort = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--trace-tasks") == 0 && i + 1 < argc) {
+            traceEvery = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--watchdog") == 0 && i + 1 < argc) {
+            watchdogMs = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--trace-events") == 0) {
+            traceEvents = true;
+        }
+    }
+
+    // Before the reactor starts its workers, so only the signalfd sees it
+    SignalHandler::blockSignal(SIGUSR1);
+    if (traceEvents) {
+        TraceRecorder::enable();
+    }
+
+    Reactor reactor;
+    // Cancels its expiry timers on destruction, so declared after reactor
+    std::unique_ptr<KvStore> kvStore;
+
+    int listenFd = listenOn(9000);
+    if (listenFd < 0) {
         return 1;
     }
 
     std::cout << "[Main] Listening on port 9000 ..." << std::endl;
 
-    // int flags = fcntl(listenFd, F_GETFL, 0);
-    // fcntl(listenFd, F_SETFL, flags | O_NONBLOCK);
+    AcceptCallback onAccept;
+    if (coro) {
+        onAccept = [&reactor](int fd) {
+            reactor.spawn(coroEchoSession(&reactor, fd));
+        };
+    } else if (kv) {
+        kvStore = std::make_unique<KvStore>(&reactor);
+        onAccept = [&reactor, store = kvStore.get()](int fd) {
+            reactor.registerHandler(std::make_shared<KvConnectionHandler>(fd, &reactor, store),
+                                    EPOLLIN | EPOLLOUT | EPOLLET);
+        };
+    } else if (ws) {
+        onAccept = [&reactor](int fd) {
+            auto echo = [](WebSocketConnectionHandler& conn, std::string_view message, bool binary) {
+                conn.send(message, binary);
+            };
+            reactor.registerHandler(std::make_shared<WebSocketConnectionHandler>(fd, &reactor, echo),
+                                    EPOLLIN | EPOLLOUT | EPOLLET);
+        };
+    } else if (pubsub) {
+        onAccept = [&reactor](int fd) {
+            reactor.registerHandler(std::make_shared<PubSubConnectionHandler>(fd, &reactor),
+                                    EPOLLIN | EPOLLOUT | EPOLLET);
+        };
+    } else if (http) {
+        onAccept = [&reactor, service = demoHttpService()](int fd) {
+            reactor.registerHandler(std::make_shared<HttpConnectionHandler>(fd, &reactor, service),
+                                    EPOLLIN | EPOLLOUT | EPOLLET);
+        };
+    }
 
-    auto acceptor = std::make_shared<AcceptorHandler>(listenFd, &reactor);
+    auto acceptor = std::make_shared<AcceptorHandler>(listenFd, &reactor, onAccept);
     reactor.registerHandler(acceptor);
 
-    reactor.addTimer(1000, true, []() {
-            std::cout << "Timer every 1s" << std::endl;
+    // Scrapes are served by the same reactor, one MetricsConnection each
+    if (metricsPort > 0) {
+        int metricsFd = listenOn(uint16_t(metricsPort));
+        if (metricsFd < 0) {
+            return 1;
+        }
+        auto metrics = std::make_shared<AcceptorHandler>(metricsFd, &reactor, [&reactor](int fd) {
+                reactor.registerHandler(std::make_shared<MetricsConnection>(fd, &reactor),
+                                        EPOLLIN | EPOLLOUT | EPOLLET);
+                });
+        reactor.registerHandler(metrics);
+        std::cout << "[Main] Metrics on port " << metricsPort << " ..." << std::endl;
+    }
+
+    // kill -USR1 <pid> writes the timeline to a file, from a worker
+    reactor.registerHandler(std::make_shared<SignalHandler>(SIGUSR1, [&reactor]() {
+            std::string path = "reactor-trace-" + std::to_string(getpid()) + ".json";
+            TaskOptions opts;
+            opts.name = "trace_export";
+            reactor.submitTask(
+                    opts,
+                    [path]() { return TraceRecorder::writeChromeTrace(path); },
+                    [path](bool written) {
+                        if (written) {
+                            std::cout << "[Main] Trace written to " << path << std::endl;
+                        } else {
+                            std::cerr << "[Main] Cannot write " << path << std::endl;
+                        }
+                    });
+            }));
+
+    reactor.setLoopProfiling(profile);
+    reactor.setTaskTracing(uint32_t(traceEvery));
+    reactor.setStallWatchdog(std::chrono::milliseconds(watchdogMs));
+
+    reactor.addTimer(1000, true, [&reactor, profile]() {
+            WorkerPoolStats stats = reactor.workerStats();
+            std::cout << "Timer every 1s: tasks executed=" << stats.executed
+                      << " cancelled=" << stats.cancelled
+                      << " deadline_missed=" << stats.deadlineMissed << std::endl;
+
+            if (!profile) {
+                return;
+            }
+            const LoopProfiler& profiler = reactor.loopProfiler();
+            for (size_t i = 0; i < loopPhaseCount; i++) {
+                const LatencyHistogram& h = profiler.histogram(LoopPhase(i));
+                std::cout << "  " << loopPhaseName(LoopPhase(i))
+                          << ": n=" << h.count()
+                          << " p50=" << h.percentile(0.50)
+                          << "ns p99=" << h.percentile(0.99)
+                          << "ns max=" << h.max() << "ns" << std::endl;
+            }
             });
 
     reactor.eventLoop();